@@ -13,6 +13,7 @@
 
 #include <tuple>
 #include "NCSF.h"
+#include "ThreadPool.h"
 
 static const std::string TWOSFTAGSTONCSF_VERSION = "1.3";
 
@@ -37,6 +38,19 @@ const option::Descriptor opts[] =
 typedef std::map<std::string, std::tuple<uint16_t, const SSEQ *, TagList>> TwoSFs;
 typedef std::map<std::string, std::pair<uint32_t, TagList>> NCSFs;
 
+// What is read from each 2SF or NCSF on its own thread, before they are merged
+// in filename order
+struct LoadedPSF
+{
+	TagList tags;
+	std::unique_ptr<SDAT> sdat;
+	uint32_t SSEQNumber;
+
+	LoadedPSF() : tags(), sdat(), SSEQNumber(0)
+	{
+	}
+};
+
 int main(int argc, char *argv[])
 {
 	// Options parsing
@@ -68,39 +82,47 @@ int main(int argc, char *argv[])
 	std::string twoSFExtensions[] = { ".2sf", ".mini2sf", ".2sflib" };
 	auto twoSFExtensionsVector = std::vector<std::string>(twoSFExtensions, twoSFExtensions + 3);
 	Files twoSFFiles = GetFilesInDirectory(twoSFDirectory, twoSFExtensionsVector);
+	std::sort(twoSFFiles.begin(), twoSFFiles.end());
 
 	std::map<std::string, SDAT> twoSFSDATs;
 	TwoSFs twoSFs;
-	uint8_t sdatSignature[] = { 0x53, 0x44, 0x41, 0x54, 0xFF, 0xFE, 0x00, 0x01 };
-	std::vector<uint8_t> sdatSignatureVector(sdatSignature, sdatSignature + 8);
-	// Get the tags and sdats from the 2SFs
-	std::for_each(twoSFFiles.begin(), twoSFFiles.end(), [&](const std::string &filename)
+	// Get the tags and sdats from the 2SFs, several files at a time
+	ThreadPool pool;
+	LoadInOrder<LoadedPSF>(pool, twoSFFiles, [&](const std::string &filename, LoadedPSF &loaded)
+	{
+		PseudoReadFile fileData;
+		fileData.GetDataFromFile(filename);
+
+		PSFProgramSection programSection(fileData, 0x24, 8, 4, true);
+		loaded.tags = GetTagsFromPSF(fileData, 0x24);
+		if (loaded.tags.Exists("_lib"))
+		{
+			// Only the SSEQ number is needed from a mini2SF
+			programSection.InflateTo(10);
+			loaded.SSEQNumber = ReadLE<uint16_t>(&programSection.data[8]);
+		}
+		else
+		{
+			// The ROM is only inflated as far as the end of its SDAT
+			uint32_t sdatOffset = programSection.InflatePastSDAT(8);
+			PseudoReadFile romFileData(filename);
+			romFileData.ViewData(programSection.data, 8);
+			romFileData.startOffset = sdatOffset - 8;
+
+			loaded.sdat.reset(new SDAT());
+			loaded.sdat->Read(filename, romFileData, false);
+		}
+	}, [&](const std::string &filename, LoadedPSF &loaded, const std::exception_ptr &error)
 	{
 		try
 		{
-			PseudoReadFile fileData;
-			fileData.GetDataFromFile(filename);
+			if (error)
+				std::rethrow_exception(error);
 
-			auto programSection = GetProgramSectionFromPSF(fileData, 0x24, 8, 4, true);
-			TagList tags = GetTagsFromPSF(fileData, 0x24);
-			if (tags.Exists("_lib"))
-			{
-				uint16_t SSEQNumber = ReadLE<uint16_t>(&programSection[8]);
-				twoSFs.insert(std::make_pair(filename, std::make_tuple(SSEQNumber, nullptr, tags)));
-			}
+			if (loaded.sdat)
+				twoSFSDATs.insert(std::make_pair(GetFilenameFromPath(filename), *loaded.sdat));
 			else
-			{
-				PseudoReadFile romFileData(filename);
-				romFileData.GetDataFromVector(programSection.begin() + 8, programSection.end());
-
-				romFileData.pos = 0;
-				romFileData.startOffset = romFileData.GetNextOffset(0, sdatSignatureVector);
-
-				SDAT sdat;
-				sdat.Read(filename, romFileData, false);
-				std::string filenameMinusPath = GetFilenameFromPath(filename);
-				twoSFSDATs.insert(std::make_pair(filenameMinusPath, sdat));
-			}
+				twoSFs.insert(std::make_pair(filename, std::make_tuple(static_cast<uint16_t>(loaded.SSEQNumber), nullptr, loaded.tags)));
 		}
 		catch (const std::exception &e)
 		{
@@ -127,38 +149,42 @@ int main(int argc, char *argv[])
 	std::string ncsfExtensions[] = { ".ncsf", ".minincsf", ".ncsflib" };
 	auto ncsfExtensionsVector = std::vector<std::string>(ncsfExtensions, ncsfExtensions + 3);
 	Files ncsfFiles = GetFilesInDirectory(NCSFDirectory, ncsfExtensionsVector);
+	std::sort(ncsfFiles.begin(), ncsfFiles.end());
 
 	SDAT ncsfSDAT;
 	NCSFs ncsfs;
-	// Get the tags and SDAT for the NCSFs
-	std::for_each(ncsfFiles.begin(), ncsfFiles.end(), [&](const std::string &filename)
+	// Get the tags and SDAT for the NCSFs, several files at a time
+	LoadInOrder<LoadedPSF>(pool, ncsfFiles, [&](const std::string &filename, LoadedPSF &loaded)
 	{
-		try
+		PseudoReadFile fileData;
+		fileData.GetDataFromFile(filename);
+
+		auto programSection = GetProgramSectionFromPSF(fileData, 0x25, 12, 8);
+		loaded.tags = GetTagsFromPSF(fileData, 0x25);
+		// If the program section is empty, this is a minincsf
+		if (programSection.empty())
+			loaded.SSEQNumber = ReadLE<uint32_t>(fileData.Data() + 16);
+		// Otherwise it is either an ncsf or an ncsflib
+		else
 		{
-			PseudoReadFile fileData;
-			fileData.GetDataFromFile(filename);
+			PseudoReadFile sdatFileData(filename);
+			sdatFileData.ViewData(programSection);
 
-			auto programSection = GetProgramSectionFromPSF(fileData, 0x25, 12, 8);
-			TagList tags = GetTagsFromPSF(fileData, 0x25);
-			// If the program section is empty, this is a minincsf
-			if (programSection.empty())
-			{
-				uint32_t SSEQNumber = ReadLE<uint32_t>(&fileData.data[16]);
-				ncsfs.insert(std::make_pair(filename, std::make_pair(SSEQNumber, tags)));
-			}
-			// Otherwise it is either an ncsf or an ncsflib
-			else
-			{
-				PseudoReadFile sdatFileData(filename);
-				sdatFileData.GetDataFromVector(programSection.begin(), programSection.end());
-
-				ncsfSDAT.Read(filename, sdatFileData);
-				if (!tags.Empty())
-					ncsfs.insert(std::make_pair(filename, std::make_pair(0, tags)));
-			}
+			loaded.sdat.reset(new SDAT());
+			loaded.sdat->Read(filename, sdatFileData);
 		}
-		catch (const std::exception &)
+	}, [&](const std::string &filename, LoadedPSF &loaded, const std::exception_ptr &error)
+	{
+		if (error)
+			return;
+
+		if (!loaded.sdat)
+			ncsfs.insert(std::make_pair(filename, std::make_pair(loaded.SSEQNumber, loaded.tags)));
+		else
 		{
+			ncsfSDAT = *loaded.sdat;
+			if (!loaded.tags.Empty())
+				ncsfs.insert(std::make_pair(filename, std::make_pair(0, loaded.tags)));
 		}
 	});
 	// Copy the tag data from the 2SFs to the NCSFs
@@ -1,19 +1,32 @@
 /*
  * 2SF to NCSF
  * By Naram Qashat (CyberBotX) [cyberbotx@cyberbotx.com]
- * Last modification on 2014-12-08
+ * Last modification on 2026-10-16
  *
  * Version history:
  *   v1.0 - 2014-10-29 - Initial version
  *   v1.1 - 2012-12-08 - Minor cleanup of PseudoReadFile to not use a pointer.
+ *   v1.3 - 2026-10-16 - Added an option to measure the loudness of each track
+ *                       while timing it and store it in ReplayGain tags.
+ *                     - Added an option to store the loop points of looping
+ *                       tracks in tags.
+ *                     - Added fast, default and max compression profiles for
+ *                       the NCSFs.
+ *                     - NCSFs from a previous run that would come out the same
+ *                       are left untouched, with an option to force rewriting
+ *                       them.
+ *                     - Added an option to write the NCSFs into a single zip
+ *                       archive.
  */
 
 #include <tuple>
 #include "NCSF.h"
+#include "NCSFWriter.h"
+#include "ThreadPool.h"
 
-static const std::string TWOSFTONCSF_VERSION = "1.2";
+static const std::string TWOSFTONCSF_VERSION = "1.3";
 
-enum { UNKNOWN, HELP, VERBOSE, TIME, FADELOOP, FADEONESHOT, EXCLUDETAG };
+enum { UNKNOWN, HELP, VERBOSE, TIME, FADELOOP, FADEONESHOT, REPLAYGAIN, LOOPTAGS, EXCLUDETAG, COMPRESSION, FORCE, ZIP };
 const option::Descriptor opts[] =
 {
 	option::Descriptor(UNKNOWN, 0, "", "", option::Arg::None, "2SF to NCSF v" + TWOSFTONCSF_VERSION + "\nBy Naram Qashat (CyberBotX) [cyberbotx@cyberbotx.com]\nand James Pelster (jpmac26 / CaptainSwag101)\n\n"
@@ -27,7 +40,22 @@ const option::Descriptor opts[] =
 		"  --time,-t \tCalculate time on each track to the number of loops given. Defaults to 2 loops. 0 will disable timing."),
 	option::Descriptor(FADELOOP, 0, "l", "fade-loop", RequireNumericArgument, "  --fade-loop,-l \tSet the fade time for looping tracks, in seconds, defaults to 10."),
 	option::Descriptor(FADEONESHOT, 0, "o", "fade-one-shot", RequireNumericArgument, "  --fade-one-shot,-o \tSet the fade time for one-shot tracks, in seconds, defaults to 0."),
+	option::Descriptor(REPLAYGAIN, 0, "g", "replaygain", option::Arg::None,
+		"  --replaygain,-g \tMeasure the loudness of each track while timing it and store it in the replaygain_track_gain and replaygain_track_peak tags. "
+			"This is much slower than timing alone."),
+	option::Descriptor(LOOPTAGS, 0, "L", "loop-tags", RequireNumericArgument,
+		"  --loop-tags=<rate> \v            -L <rate> \tStore the loop points of looping tracks in the loop_start and loop_end tags, and in samples at the given "
+			"sample rate in the loop_start_samples and loop_end_samples tags."),
 	option::Descriptor(EXCLUDETAG, 0, "x", "exclude", RequireArgument, "  --exclude=<tag> \v         -x <tag> \tExclude the given tag from the tags to copy."),
+	option::Descriptor(COMPRESSION, 0, "c", "compression", RequireArgument,
+		"  --compression=<profile> \v             -c <profile> \tHow hard to compress the NCSFs: fast (zlib level 1, for quick test runs), default (level 9) "
+			"or max (tries several zlib settings at once and keeps whichever is smallest, much slower). Verbose output shows the size and time for each file."),
+	option::Descriptor(FORCE, 0, "f", "force", option::Arg::None,
+		"  --force,-f \tRewrite every NCSF. Without this, files from a previous run that would come out the same are left untouched, whichever profile they were "
+			"compressed with."),
+	option::Descriptor(ZIP, 0, "z", "zip", option::Arg::None,
+		"  --zip,-z \tWrite the NCSFs into a single zip archive named after the output directory, instead of into the directory. The NCSFs are stored in it "
+			"uncompressed, as they are already compressed."),
 	option::Descriptor(UNKNOWN, 0, "", "", option::Arg::None,
 		"\nThis tool only works with 2SF sets created with Caitsith2's Legacy of Ys driver, and not older sets such as those using the Yoshi's Island DS driver."
 		"\n\nIf the output NCSFLIB filename is not given, attempts to infer the filename will be made."
@@ -39,6 +67,20 @@ const option::Descriptor opts[] =
 
 typedef std::map<std::string, std::tuple<uint16_t, TagList>> TwoSFs;
 
+// What is read from each 2SF on its own thread, before they are merged in
+// filename order
+struct LoadedTwoSF
+{
+	TagList tags;
+	std::unique_ptr<SDAT> sdat;
+	uint16_t SSEQNumber;
+	bool hasSSEQ;
+
+	LoadedTwoSF() : tags(), sdat(), SSEQNumber(0), hasSSEQ(false)
+	{
+	}
+};
+
 int main(int argc, char *argv[])
 {
 	// Options parsing
@@ -71,6 +113,15 @@ int main(int argc, char *argv[])
 	uint32_t fadeOneShot = 1;
 	if (options[FADEONESHOT])
 		fadeOneShot = convertTo<uint32_t>(options[FADEONESHOT].arg);
+	uint32_t loopSampleRate = 0;
+	if (options[LOOPTAGS])
+		loopSampleRate = convertTo<uint32_t>(options[LOOPTAGS].arg);
+	Compression compression = COMPRESSION_DEFAULT;
+	if (options[COMPRESSION] && !GetCompressionFromName(options[COMPRESSION].arg, compression))
+	{
+		std::cerr << "Error: Unknown compression profile " << options[COMPRESSION].arg << ".\n";
+		return 1;
+	}
 
 	std::string twoSFDirectory = parse.nonOption(0);
 	std::replace(twoSFDirectory.begin(), twoSFDirectory.end(), '\\', '/');
@@ -85,56 +136,71 @@ int main(int argc, char *argv[])
 
 	std::map<std::string, SDAT> twoSFSDATs;
 	TwoSFs twoSFs;
-	uint8_t sdatSignature[] = { 0x53, 0x44, 0x41, 0x54, 0xFF, 0xFE, 0x00, 0x01 };
-	std::vector<uint8_t> sdatSignatureVector(sdatSignature, sdatSignature + 8);
-	// Get the tags and sdats from the 2SFs
-	std::for_each(twoSFFiles.begin(), twoSFFiles.end(), [&](const std::string &filename)
+	// Get the tags and sdats from the 2SFs, several files at a time
+	ThreadPool pool;
+	LoadInOrder<LoadedTwoSF>(pool, twoSFFiles, [&](const std::string &filename, LoadedTwoSF &loaded)
+	{
+		PseudoReadFile fileData;
+		fileData.GetDataFromFile(filename);
+
+		PSFProgramSection programSection(fileData, 0x24, 8, 4, true);
+		loaded.tags = GetTagsFromPSF(fileData, 0x24);
+		if (loaded.tags.Exists("_lib"))
+		{
+			// Only the SSEQ number is needed from a mini2SF
+			programSection.InflateTo(10);
+			if (programSection.data.empty())
+				throw std::runtime_error("This 2SF had no program section!");
+			loaded.SSEQNumber = ReadLE<uint16_t>(&programSection.data[8]);
+			loaded.hasSSEQ = true;
+		}
+		else
+		{
+			PseudoReadFile romFileData(filename);
+			programSection.InflateTo(20);
+			romFileData.ViewData(programSection.data, 8);
+
+			char gameNameArray[12];
+			romFileData.ReadLE(gameNameArray);
+			std::string gameName = std::string(gameNameArray, gameNameArray + 12);
+			if (gameName != "LEGACY OF YS")
+				throw std::runtime_error("This tool only works on the Legacy of Ys ROM, but I got '" + gameName + "' instead.");
+
+			// The ROM is only inflated as far as the end of its SDAT
+			uint32_t sdatOffset = programSection.InflatePastSDAT(8);
+			romFileData.ViewData(programSection.data, 8);
+			romFileData.startOffset = sdatOffset - 8;
+
+			loaded.sdat.reset(new SDAT());
+			loaded.sdat->Read(filename, romFileData, false);
+			if (!loaded.tags.Empty())
+			{
+				programSection.InflateTo(0x0d0fca);
+				loaded.SSEQNumber = ReadLE<uint16_t>(&programSection.data[0x0d0fc8]);
+				loaded.hasSSEQ = true;
+			}
+		}
+	}, [&](const std::string &filename, LoadedTwoSF &loaded, const std::exception_ptr &error)
 	{
 		if (!!options[VERBOSE])
 			std::cout << "Processing " << filename << "\n";
 		try
 		{
-			PseudoReadFile fileData;
-			fileData.GetDataFromFile(filename);
+			if (error)
+				std::rethrow_exception(error);
 
-			auto programSection = GetProgramSectionFromPSF(fileData, 0x24, 8, 4, true);
-			TagList tags = GetTagsFromPSF(fileData, 0x24);
-			if (tags.Exists("_lib"))
+			if (loaded.sdat)
 			{
-				if (programSection.empty())
-					throw std::runtime_error("This 2SF had no program section!");
-				uint16_t SSEQNumber = ReadLE<uint16_t>(&programSection[8]);
-				twoSFs.insert(std::make_pair(filename, std::make_tuple(SSEQNumber, tags)));
-			}
-			else
-			{
-				PseudoReadFile romFileData(filename);
-				romFileData.GetDataFromVector(programSection.begin() + 8, programSection.end());
-
-				char gameNameArray[12];
-				romFileData.ReadLE(gameNameArray);
-				std::string gameName = std::string(gameNameArray, gameNameArray + 12);
-				if (gameName != "LEGACY OF YS")
-					throw std::runtime_error("This tool only works on the Legacy of Ys ROM, but I got '" + gameName + "' instead.");
-
-				romFileData.pos = 0;
-				romFileData.startOffset = romFileData.GetNextOffset(0, sdatSignatureVector);
-
-				SDAT sdat;
-				sdat.Read(filename, romFileData, false);
 				std::string filenameMinusPath = GetFilenameFromPath(filename);
-				twoSFSDATs.insert(std::make_pair(filenameMinusPath, sdat));
-				if (ncsflibFilename.empty() && tags.Empty())
+				twoSFSDATs.insert(std::make_pair(filenameMinusPath, *loaded.sdat));
+				if (ncsflibFilename.empty() && loaded.tags.Empty())
 				{
 					size_t dot = filenameMinusPath.rfind('.');
 					ncsflibFilename = filenameMinusPath.substr(0, dot) + ".ncsflib";
 				}
-				if (!tags.Empty())
-				{
-					uint16_t SSEQNumber = ReadLE<uint16_t>(&programSection[0x0d0fc8]);
-					twoSFs.insert(std::make_pair(filename, std::make_tuple(SSEQNumber, tags)));
-				}
 			}
+			if (loaded.hasSSEQ)
+				twoSFs.insert(std::make_pair(filename, std::make_tuple(loaded.SSEQNumber, loaded.tags)));
 		}
 		catch (const std::exception &e)
 		{
@@ -179,34 +245,46 @@ int main(int argc, char *argv[])
 	finalSDAT.count = 1;
 	finalSDAT.Strip(IncOrExc(), options[VERBOSE].count() > 1);
 
-	// Setup the output directory, making sure it is clear beforehand (if it exists)
+	// Setup the output directory, the files from a previous run (if it exists)
+	// are only removed once the new ones have been written, so that any that
+	// are unchanged can be kept as they are
 	std::string NCSFDirectory = twoSFDirectory;
 	if (twoSFDirectory[twoSFDirectory.size() - 1] == '/')
 		NCSFDirectory = NCSFDirectory.substr(0, twoSFDirectory.size() - 1);
 	NCSFDirectory += "_2SFtoNCSF";
-	if (DirExists(NCSFDirectory))
+	std::string zipFilename = NCSFDirectory + ".zip";
+	Files previousFiles;
+	// The directory is left alone when writing a zip archive instead
+	if (!options[ZIP])
 	{
-		std::string extensions[] = { ".ncsf", ".minincsf", ".ncsflib" };
-		auto extensionsVector = std::vector<std::string>(extensions, extensions + 3);
-		Files files = GetFilesInDirectory(NCSFDirectory, extensionsVector);
-		RemoveFiles(files);
+		if (DirExists(NCSFDirectory))
+		{
+			std::string extensions[] = { ".ncsf", ".minincsf", ".ncsflib" };
+			auto extensionsVector = std::vector<std::string>(extensions, extensions + 3);
+			previousFiles = GetFilesInDirectory(NCSFDirectory, extensionsVector);
+		}
+		else
+			MakeDir(NCSFDirectory);
 	}
-	else
-		MakeDir(NCSFDirectory);
 	if (options[VERBOSE])
-		std::cout << "Output will go to " << NCSFDirectory << "\n";
+		std::cout << "Output will go to " << (options[ZIP] ? zipFilename : NCSFDirectory) << "\n";
 
-	// Create vector data for SDAT
-	PseudoWrite sdatData;
+	// Gather the SDAT's data, its files are compressed from where they are
+	GatherList sdatData;
 	finalSDAT.Write(sdatData);
 
+	// The files are compressed and written while the next track is timed, and
+	// files that would come out the same are left alone, unless told to
+	// rewrite them all
+	NCSFWriter writer(!!options[VERBOSE], compression, !options[FORCE]);
+	if (options[ZIP])
+		writer.OpenArchive(zipFilename);
+
 	bool singleNCSF = finalSDAT.infoSection.SEQrecord.count == 1;
 	if (!singleNCSF)
 	{
 		// Make NCSFLIB if we are creating more than one NCSF
-		MakeNCSF(NCSFDirectory + "/" + ncsflibFilename, std::vector<uint8_t>(), sdatData.vector->data);
-		if (options[VERBOSE])
-			std::cout << "Created " << ncsflibFilename << "\n";
+		writer.Add(NCSFDirectory + "/" + ncsflibFilename, std::vector<uint8_t>(), sdatData);
 	}
 	for (size_t i = 0, sseqs = finalSDAT.infoSection.SEQrecord.count; i < sseqs; ++i)
 	{
@@ -225,19 +303,18 @@ int main(int argc, char *argv[])
 		std::string filename = GetFilenameFromPath(origFilename);
 		size_t dot = filename.rfind('.');
 		filename = filename.substr(0, dot) + (singleNCSF ? ".ncsf" : ".minincsf");
-		std::vector<uint8_t> programData;
-		if (singleNCSF)
-			programData = sdatData.vector->data;
 
 		auto reservedData = IntToLEVector<uint32_t>(i);
 
 		if (numberOfLoops)
-			GetTime(filename, &finalSDAT, finalSDAT.infoSection.SEQrecord.entries[i].sseq, tags, !!options[VERBOSE], numberOfLoops, fadeLoop, fadeOneShot);
+			GetTime(filename, &finalSDAT, finalSDAT.infoSection.SEQrecord.entries[i].sseq, tags, !!options[VERBOSE], numberOfLoops, fadeLoop, fadeOneShot, !!options[REPLAYGAIN], loopSampleRate);
 
-		MakeNCSF(NCSFDirectory + "/" + filename, reservedData, programData, tags.GetTags());
-		if (options[VERBOSE])
-			std::cout << "Created " << filename << "\n";
+		if (singleNCSF)
+			writer.Add(NCSFDirectory + "/" + filename, reservedData, sdatData, tags.GetTags());
+		else
+			writer.Add(NCSFDirectory + "/" + filename, reservedData, tags.GetTags());
 	}
+	writer.Finish(previousFiles);
 
 	return 0;
 }
@@ -1,7 +1,7 @@
 /*
  * NDS to NCSF
  * By Naram Qashat (CyberBotX) [cyberbotx@cyberbotx.com]
- * Last modification on 2014-12-09
+ * Last modification on 2026-10-16
  *
  * Version history:
  *   v1.0 - 2013-03-25 - Initial version
@@ -29,22 +29,42 @@
  *   v1.7 - 2014-12-09 - Added functionality to strip the SBNKs and SWARs of
  *                       the SDAT prior to saving it.
  *                     - Minor cleanup of PseudoReadFile to not use a pointer.
+ *   v1.8 - 2026-10-16 - Added an option to measure the loudness of each track
+ *                       while timing it and store it in ReplayGain tags.
+ *                     - Added an option to store the loop points of looping
+ *                       tracks in tags.
+ *                     - NDS ROMs can be read directly from zip archives.
+ *                     - Gzipped NDS ROMs can be read, and are scanned as they
+ *                       are inflated.
+ *                     - Added fast, default and max compression profiles for
+ *                       the NCSFs.
+ *                     - NCSFs from a previous run that would come out the same
+ *                       are left untouched, with an option to force rewriting
+ *                       them.
+ *                     - Added an option to write the NCSFs into a single zip
+ *                       archive.
  */
 
 #include <iomanip>
+#include <deque>
 #include "NCSF.h"
+#include "NitroFS.h"
 #include "TimerTrack.h"
+#include "NCSFWriter.h"
+#include "ThreadPool.h"
 
-static const std::string NDSTONCSF_VERSION = "1.7.1";
+static const std::string NDSTONCSF_VERSION = "1.8";
 
-enum { UNKNOWN, HELP, VERBOSE, TIME, FADELOOP, FADEONESHOT, EXCLUDE, INCLUDE, AUTO, CREATE_SMAP, USE_SMAP, NOCOPY, RENAME };
+enum { UNKNOWN, HELP, VERBOSE, TIME, FADELOOP, FADEONESHOT, REPLAYGAIN, LOOPTAGS, EXCLUDE, INCLUDE, AUTO, CREATE_SMAP, USE_SMAP, NOCOPY, RENAME, COMPRESSION, FORCE, ZIP };
 const option::Descriptor opts[] =
 {
 	option::Descriptor(UNKNOWN, 0, "", "", option::Arg::None, "NDS to NCSF v" + NDSTONCSF_VERSION + "\nBy Naram Qashat (CyberBotX) [cyberbotx@cyberbotx.com]\nand James Pelster (jpmac26 / CaptainSwag101)\n\n"
 		"NDS to NCSF will take the incoming NDS ROM and create a series of NCSF files. If there is only a single SSEQ within the entire ROM, then there will be a "
 			"single NCSF file. Otherwise, there will be an NCSFLIB and multiple MININCSFs.\n\n"
 		"Usage:\n"
-		"  NDStoNCSF [options] <Input SDAT filename>\n\n"
+		"  NDStoNCSF [options] <Input SDAT filename>\n"
+		"  (The input can also be a zip archive, given as <archive>.zip:<ROM filename> or just <archive>.zip if it holds a single NDS ROM, or\n"
+		"  a gzipped ROM.)\n\n"
 		"Options:"),
 	option::Descriptor(HELP, 0, "h", "help", option::Arg::None, "  --help,-h \tPrint usage and exit."),
 	option::Descriptor(VERBOSE, 0, "v", "verbose", option::Arg::None, "  --verbose,-v \tVerbose output."),
@@ -52,6 +72,12 @@ const option::Descriptor opts[] =
 		"  --time,-t \tCalculate time on each track to the number of loops given. Defaults to 2 loops. 0 will disable timing."),
 	option::Descriptor(FADELOOP, 0, "l", "fade-loop", RequireNumericArgument, "  --fade-loop,-l \tSet the fade time for looping tracks, in seconds, defaults to 10."),
 	option::Descriptor(FADEONESHOT, 0, "o", "fade-one-shot", RequireNumericArgument, "  --fade-one-shot,-o \tSet the fade time for one-shot tracks, in seconds, defaults to 0."),
+	option::Descriptor(REPLAYGAIN, 0, "g", "replaygain", option::Arg::None,
+		"  --replaygain,-g \tMeasure the loudness of each track while timing it and store it in the replaygain_track_gain and replaygain_track_peak tags. "
+			"This is much slower than timing alone."),
+	option::Descriptor(LOOPTAGS, 0, "L", "loop-tags", RequireNumericArgument,
+		"  --loop-tags=<rate> \v            -L <rate> \tStore the loop points of looping tracks in the loop_start and loop_end tags, and in samples at the given "
+			"sample rate in the loop_start_samples and loop_end_samples tags."),
 	option::Descriptor(EXCLUDE, 0, "x", "exclude", RequireArgument,
 		"  --exclude=<filename> \v         -x <filename> \tExclude the given filename from the final SDAT. May use * and ? wildcards."),
 	option::Descriptor(INCLUDE, 0, "i", "include", RequireArgument,
@@ -63,6 +89,15 @@ const option::Descriptor opts[] =
 		"  --use-smap=<filename> \v          -S <filename> \tUses the given SMAP-like file to determine what files to include/exclude."),
 	option::Descriptor(NOCOPY, 0, "n", "nocopy", option::Arg::None, "  --nocopy,-n \tDo not check for previous files in the destination directory."),
 	option::Descriptor(RENAME, 0, "r", "rename", option::Arg::None, "  --rename,-r \tPrepend the song number to miniNCSF filenames. Use this if multiple songs share the same filename."),
+	option::Descriptor(COMPRESSION, 0, "c", "compression", RequireArgument,
+		"  --compression=<profile> \v             -c <profile> \tHow hard to compress the NCSFs: fast (zlib level 1, for quick test runs), default (level 9) "
+			"or max (tries several zlib settings at once and keeps whichever is smallest, much slower). Verbose output shows the size and time for each file."),
+	option::Descriptor(FORCE, 0, "f", "force", option::Arg::None,
+		"  --force,-f \tRewrite every NCSF. Without this, files from a previous run that would come out the same are left untouched, whichever profile they were "
+			"compressed with."),
+	option::Descriptor(ZIP, 0, "z", "zip", option::Arg::None,
+		"  --zip,-z \tWrite the NCSFs into a single zip archive named after the output directory, instead of into the directory. The NCSFs are stored in it "
+			"uncompressed, as they are already compressed."),
 	option::Descriptor(UNKNOWN, 0, "", "", option::Arg::None,
 		"\nVerbose output will output the NCSFs created. If given more than once, verbose output will also output duplicates found during the SDAT stripping step."
 		"\n\nExcluded and included files will be processed in the order they are given on the command line, later arguments overriding earlier arguments. If there is more "
@@ -123,6 +158,56 @@ static bool CompareSSEQData(const std::vector<uint8_t> &dataA, const std::vector
 
 typedef std::multimap<std::string, SSEQ> OldSDATFilesMap;
 
+// What is read from each file of a previous run on its own thread, before they
+// are merged in filename order
+struct PreviousNCSF
+{
+	OldSDATFilesMap oldSDATFiles;
+	TagList tags;
+	bool hasTags;
+
+	PreviousNCSF() : oldSDATFiles(), tags(), hasTags(false)
+	{
+	}
+};
+
+// An SDAT found while scanning a compressed ROM, which is gathered from the
+// blocks of the ROM as the scan reads them, as the ROM can only be inflated
+// forwards.  Its size is only known once its header has been gathered, and it
+// is cut short by the end of the ROM the same as a read would be.
+struct GatheredSDAT
+{
+	uint64_t offset;
+	uint32_t size;
+	bool sizeKnown;
+	std::vector<uint8_t> data;
+
+	GatheredSDAT(uint64_t sdatOffset) : offset(sdatOffset), size(0), sizeKnown(false), data()
+	{
+	}
+
+	bool Complete() const
+	{
+		return this->sizeKnown && this->data.size() >= this->size;
+	}
+
+	void Gather(uint64_t blockStart, const std::vector<uint8_t> &block)
+	{
+		uint64_t position = this->offset + this->data.size(), blockEnd = blockStart + block.size();
+		if (this->Complete() || position < blockStart || position >= blockEnd)
+			return;
+		uint64_t end = this->sizeKnown ? std::min(blockEnd, this->offset + this->size) : blockEnd;
+		this->data.insert(this->data.end(), block.begin() + static_cast<size_t>(position - blockStart), block.begin() + static_cast<size_t>(end - blockStart));
+		if (!this->sizeKnown && this->data.size() >= 12)
+		{
+			this->size = LoadLE<uint32_t>(&this->data[8]);
+			this->sizeKnown = true;
+			if (this->data.size() > this->size)
+				this->data.resize(this->size);
+		}
+	}
+};
+
 int main(int argc, char *argv[])
 {
 	// Options parsing
@@ -175,6 +260,15 @@ int main(int argc, char *argv[])
 	uint32_t fadeOneShot = 1;
 	if (options[FADEONESHOT])
 		fadeOneShot = convertTo<uint32_t>(options[FADEONESHOT].arg);
+	uint32_t loopSampleRate = 0;
+	if (options[LOOPTAGS])
+		loopSampleRate = convertTo<uint32_t>(options[LOOPTAGS].arg);
+	Compression compression = COMPRESSION_DEFAULT;
+	if (options[COMPRESSION] && !GetCompressionFromName(options[COMPRESSION].arg, compression))
+	{
+		std::cerr << "Error: Unknown compression profile " << options[COMPRESSION].arg << ".\n";
+		return 1;
+	}
 
 	try
 	{
@@ -182,96 +276,112 @@ int main(int argc, char *argv[])
 		std::string ndsFilename = parse.nonOption(0);
 		std::replace(ndsFilename.begin(), ndsFilename.end(), '\\', '/');
 
-		if (!FileExists(ndsFilename))
-			throw std::runtime_error("File " + ndsFilename + " does not exist.");
+		std::string archiveFilename, memberFilename;
+		bool inArchive = SplitArchivePath(ndsFilename, archiveFilename, memberFilename);
+		if (!FileExists(inArchive ? archiveFilename : ndsFilename))
+			throw std::runtime_error("File " + (inArchive ? archiveFilename : ndsFilename) + " does not exist.");
 
-		PseudoReadFile fileData;
-		fileData.GetDataFromFile(ndsFilename);
+		// Only the ROM header is loaded up front, everything else is read from
+		// the ROM as it is needed
+		RangedFile romFile;
+		romFile.Open(ndsFilename, ".nds");
+		PseudoReadFile headerData(ndsFilename);
+		headerData.GetDataFromFile(romFile, 0, 0x200);
 
 		// Setup the output directory, making sure it is clear beforehand (if it
 		// exists and we aren't being told not to copy the old data, then we'll
 		// get all that data first)
-		std::string dirName = ndsFilename;
+		std::string dirName = GetArchiveOutputPath(ndsFilename);
 		size_t dot = dirName.rfind('.');
 		dirName = dirName.substr(0, dot) + "_NDStoNCSF";
+		std::string zipFilename = dirName + ".zip";
 
 		std::map<std::string, TagList> savedTags;
 		std::map<std::string, std::string> filenames;
 		OldSDATFilesMap oldSDATFiles;
+		// The previous files are only removed once the new ones have been
+		// written, so that any that are unchanged can be kept as they are
+		Files previousFiles;
 		if (DirExists(dirName))
 		{
 			std::string extensions[] = { ".ncsf", ".minincsf", ".ncsflib" };
 			auto extensionsVector = std::vector<std::string>(extensions, extensions + 3);
-			Files files = GetFilesInDirectory(dirName, extensionsVector);
+			previousFiles = GetFilesInDirectory(dirName, extensionsVector);
 
 			if (!options[NOCOPY])
-				for (auto curr = files.begin(), end = files.end(); curr != end; ++curr)
+			{
+				std::sort(previousFiles.begin(), previousFiles.end());
+				ThreadPool pool;
+				LoadInOrder<PreviousNCSF>(pool, previousFiles, [&](const std::string &file, PreviousNCSF &previous)
 				{
-					try
+					// Only the files with an SDAT are read in full, the rest only
+					// have their tags read
+					PseudoReadFile ncsfFileData;
+					bool hasSDAT = file.rfind(".ncsf") != std::string::npos || file.rfind(".ncsflib") != std::string::npos;
+					if (hasSDAT)
 					{
-						PseudoReadFile ncsfFileData;
-						ncsfFileData.GetDataFromFile(*curr);
+						ncsfFileData.GetDataFromFile(file);
 
-						if (curr->rfind(".ncsf") != std::string::npos || curr->rfind(".ncsflib") != std::string::npos)
-						{
-							auto sdatVector = GetProgramSectionFromPSF(ncsfFileData, 0x25, 12, 8);
-							if (sdatVector.empty())
-								throw std::runtime_error("Program section for " + *curr + " was empty.");
-
-							PseudoReadFile sdatFileData(*curr);
-							sdatFileData.GetDataFromVector(sdatVector.begin(), sdatVector.end());
-
-							SDAT sdat;
-							sdat.Read(*curr, sdatFileData);
-							if (sdat.SYMBOffset)
-								for (uint32_t i = 0; i < sdat.symbSection.SEQrecord.count; ++i)
-									oldSDATFiles.insert(std::make_pair(sdat.symbSection.SEQrecord.entries[i], *sdat.infoSection.SEQrecord.entries[i].sseq));
-						}
-						if (curr->rfind(".ncsf") != std::string::npos || curr->rfind(".minincsf") != std::string::npos)
-						{
-							std::string filename = GetFilenameFromPath(*curr);
-							TagList tags = GetTagsFromPSF(ncsfFileData, 0x25);
-							// If 2SF to NCSF was used, don't use the tags for this file at all,
-							// they might not be valid for use with NDS to NCSF's purposes.
-							if (tags.Exists("ncsfby") && tags["ncsfby"] != "2SF to NCSF")
-							{
-								if (tags.Exists("origFilename"))
-								{
-									std::string fullOrigFilename = tags["origFilename"];
-									if (tags.Exists("origSDAT"))
-										fullOrigFilename = tags["origSDAT"] + "/" + fullOrigFilename;
-									savedTags[fullOrigFilename] = tags;
-									filenames[fullOrigFilename] = filename;
-								}
-								else
-									savedTags[filename] = tags;
-							}
-						}
+						auto sdatVector = GetProgramSectionFromPSF(ncsfFileData, 0x25, 12, 8);
+						if (sdatVector.empty())
+							throw std::runtime_error("Program section for " + file + " was empty.");
+
+						PseudoReadFile sdatFileData(file);
+						sdatFileData.ViewData(sdatVector);
+
+						SDAT sdat;
+						sdat.Read(file, sdatFileData);
+						if (sdat.SYMBOffset)
+							for (uint32_t i = 0; i < sdat.symbSection.SEQrecord.count; ++i)
+								previous.oldSDATFiles.insert(std::make_pair(sdat.symbSection.SEQrecord.entries[i], *sdat.infoSection.SEQrecord.entries[i].sseq));
 					}
-					catch (const std::exception &)
+					if (file.rfind(".ncsf") != std::string::npos || file.rfind(".minincsf") != std::string::npos)
 					{
+						previous.tags = hasSDAT ? GetTagsFromPSF(ncsfFileData, 0x25) : GetTagsFromPSF(file, 0x25);
+						previous.hasTags = true;
 					}
-				}
-
-			// Only remove the files if we are not creating an SMAP
-			if (!options[CREATE_SMAP])
-				RemoveFiles(files);
+				}, [&](const std::string &file, PreviousNCSF &previous, const std::exception_ptr &error)
+				{
+					if (error)
+						return;
+
+					oldSDATFiles.insert(previous.oldSDATFiles.begin(), previous.oldSDATFiles.end());
+					const TagList &tags = previous.tags;
+					// If 2SF to NCSF was used, don't use the tags for this file at all,
+					// they might not be valid for use with NDS to NCSF's purposes.
+					if (previous.hasTags && tags.Exists("ncsfby") && tags["ncsfby"] != "2SF to NCSF")
+					{
+						std::string filename = GetFilenameFromPath(file);
+						if (tags.Exists("origFilename"))
+						{
+							std::string fullOrigFilename = tags["origFilename"];
+							if (tags.Exists("origSDAT"))
+								fullOrigFilename = tags["origSDAT"] + "/" + fullOrigFilename;
+							savedTags[fullOrigFilename] = tags;
+							filenames[fullOrigFilename] = filename;
+						}
+						else
+							savedTags[filename] = tags;
+					}
+				});
+			}
 		}
-		else
+		// When writing a zip archive, the directory is only needed for the SMAP
+		else if (!options[ZIP] || options[CREATE_SMAP])
 			MakeDir(dirName);
 		if (options[VERBOSE])
-			std::cout << "Output will go to " << dirName << "\n";
+			std::cout << "Output will go to " << (options[ZIP] && !options[CREATE_SMAP] ? zipFilename : dirName) << "\n";
 
 		// Get game code
-		fileData.pos = 0x0C;
+		headerData.pos = 0x0C;
 		char gameCodeArray[4];
-		fileData.ReadLE(gameCodeArray);
+		headerData.ReadLE(gameCodeArray);
 		std::string gameCode = std::string(gameCodeArray, gameCodeArray + 4);
 
 		// Get if the ROM is a DSi ROM or not
-		fileData.pos = 0x180;
-		bool DSi = fileData.ReadLE<uint32_t>() == 0x8D898581u;
-		DSi = DSi || fileData.ReadLE<uint32_t>() == 0x8C888480u;
+		headerData.pos = 0x180;
+		bool DSi = headerData.ReadLE<uint32_t>() == 0x8D898581u;
+		DSi = DSi || headerData.ReadLE<uint32_t>() == 0x8C888480u;
 
 		// Search for SDATs and merge them into one
 		SDAT finalSDAT;
@@ -280,32 +390,132 @@ int main(int argc, char *argv[])
 
 		uint8_t sdatSignature[] = { 0x53, 0x44, 0x41, 0x54, 0xFF, 0xFE, 0x00, 0x01 };
 		std::vector<uint8_t> sdatSignatureVector(sdatSignature, sdatSignature + 8);
-		int32_t sdatOffset, sdatNumber = 0;
-		uint32_t previousOffset = 0;
-		while ((sdatOffset = fileData.GetNextOffset(previousOffset, sdatSignatureVector)) != -1)
+
+		// SDATs are numbered in the order they appear in the ROM.  Only the SDAT
+		// itself is read, using the larger of the sizes from its header and
+		// from the filesystem (if it was found there), and it is released again
+		// once its files have been copied out of it.
+		int32_t sdatNumber = 0;
+		std::map<std::string, std::string> sdatPaths;
+		auto addSDAT = [&](PseudoReadFile &sdatData, const std::string &path)
 		{
 			try
 			{
-				fileData.pos = 0;
-				fileData.startOffset = sdatOffset;
 				SDAT sdat;
-				sdat.Read(stringify(sdatNumber++ + 1), fileData);
+				sdat.Read(stringify(sdatNumber++ + 1), sdatData);
 				finalSDAT += sdat;
+				if (!path.empty())
+					sdatPaths[sdat.filename] = path;
 				if (options[VERBOSE])
-					std::cout << "Found SDAT with " << sdat.infoSection.SEQrecord.actualCount << " SSEQ" << (sdat.infoSection.SEQrecord.actualCount == 1 ? "" : "s") << ".\n";
+				{
+					std::cout << "Found SDAT ";
+					if (!path.empty())
+						std::cout << path << " ";
+					std::cout << "with " << sdat.infoSection.SEQrecord.actualCount << " SSEQ" << (sdat.infoSection.SEQrecord.actualCount == 1 ? "" : "s") << ".\n";
+				}
 			}
 			catch (const std::exception &e)
 			{
 				std::cout << e.what() << std::endl;
 				--sdatNumber;
 			}
-			fileData.startOffset = 0;
-			previousOffset = sdatOffset + 1;
+		};
+		auto readSDAT = [&](const NitroFSFile &location)
+		{
+			PseudoReadFile sdatData(ndsFilename);
+			try
+			{
+				sdatData.GetDataFromFile(romFile, location.offset, 16);
+				sdatData.pos = 8;
+				uint32_t sdatSize = std::max(sdatData.ReadLE<uint32_t>(), location.size);
+				sdatData.GetDataFromFile(romFile, location.offset, sdatSize);
+			}
+			catch (const std::exception &e)
+			{
+				std::cout << e.what() << std::endl;
+				return;
+			}
+			addSDAT(sdatData, location.path);
+		};
+
+		// Only the start of each file in the ROM's filesystem needs to be
+		// checked for an SDAT, the entire ROM is only scanned if the
+		// filesystem is unusable or no SDATs were found that way.  The files
+		// are gone through in the order they are in the ROM, with each SDAT
+		// being read as soon as it is found, so a compressed ROM is inflated
+		// in a single pass that stops at the last file.
+		bool sdatsInFS = false;
+		try
+		{
+			NitroFS nitroFS;
+			nitroFS.Read(romFile, headerData);
+			std::vector<NitroFSFile> files = nitroFS.files;
+			std::stable_sort(files.begin(), files.end(), [](const NitroFSFile &a, const NitroFSFile &b) { return a.offset < b.offset; });
+			std::vector<uint8_t> fileStart;
+			uint32_t lastOffset = 0;
+			std::for_each(files.begin(), files.end(), [&](const NitroFSFile &file)
+			{
+				if (file.size < sdatSignatureVector.size() || (sdatsInFS && file.offset == lastOffset))
+					return;
+				romFile.Read(file.offset, sdatSignatureVector.size(), fileStart);
+				if (fileStart != sdatSignatureVector)
+					return;
+				sdatsInFS = true;
+				lastOffset = file.offset;
+				readSDAT(file);
+			});
+		}
+		catch (const std::exception &)
+		{
+		}
+		if (!sdatsInFS)
+		{
+			if (options[VERBOSE])
+				std::cout << "No SDATs found in the ROM's filesystem, scanning the entire ROM...\n";
+			if (romFile.IsCompressed())
+			{
+				// A compressed ROM is scanned as it is inflated instead of
+				// being inflated into memory first, and as it can only be
+				// inflated forwards, each SDAT is gathered from the blocks as
+				// the scan goes past them instead of being read afterwards.
+				// They are added once complete, in the order they were found.
+				std::deque<GatheredSDAT> gathering;
+				auto addGathered = [&](bool endOfROM)
+				{
+					while (!gathering.empty() && (endOfROM || gathering.front().Complete()))
+					{
+						PseudoReadFile sdatData(ndsFilename);
+						sdatData.GetDataFromVector(gathering.front().data.begin(), gathering.front().data.end());
+						gathering.pop_front();
+						addSDAT(sdatData, "");
+					}
+				};
+				ScanFileForSignatures(romFile, sdatSignature, sdatSignatureVector.size(), [&](uint64_t blockStart, const std::vector<uint8_t> &block,
+					const std::vector<uint32_t> &offsets)
+				{
+					gathering.insert(gathering.end(), offsets.begin(), offsets.end());
+					std::for_each(gathering.begin(), gathering.end(), [&](GatheredSDAT &sdat) { sdat.Gather(blockStart, block); });
+					addGathered(false);
+				});
+				addGathered(true);
+			}
+			else
+			{
+				PseudoReadFile romData(ndsFilename);
+				romData.MapFile(ndsFilename);
+				std::vector<uint32_t> sdatOffsets = FindAllSignatures(romData.Data(), romData.Size(), sdatSignature, sdatSignatureVector.size());
+				std::for_each(sdatOffsets.begin(), sdatOffsets.end(), [&](uint32_t sdatOffset)
+				{
+					readSDAT(NitroFSFile(sdatOffset));
+				});
+			}
 		}
 
 		// Fail if we do not have any SSEQs (which could also mean that there were no SDATs in the ROM or it wasn't an NDS ROM)
 		if (!finalSDAT.infoSection.SEQrecord.count)
 		{
+			if (!options[CREATE_SMAP] && !options[ZIP])
+				RemoveFiles(previousFiles);
 			rmdir(dirName.c_str());
 			throw std::range_error("Either there were no SSEQs within the SDATs of given NDS ROM, no SDATs in\n  the ROM, or the file was not an NDS ROM.");
 		}
@@ -502,10 +712,17 @@ int main(int argc, char *argv[])
 		finalSDAT.StripBanksAndWaveArcs();
 		finalSDAT.Strip(IncOrExc(), options[VERBOSE].count() > 1);
 
-		// Create vector data for SDAT
-		PseudoWrite sdatData;
+		// Gather the SDAT's data, its files are compressed from where they are
+		GatherList sdatData;
 		finalSDAT.Write(sdatData);
 
+		// The files are compressed and written while the next track is timed,
+		// and files that would come out the same are left alone, unless told
+		// to rewrite them all
+		NCSFWriter writer(!!options[VERBOSE], compression, !options[FORCE]);
+		if (options[ZIP])
+			writer.OpenArchive(zipFilename);
+
 		if (finalSDAT.infoSection.SEQrecord.entries.size() == 1)
 		{
 			// Make single NCSF
@@ -522,11 +739,9 @@ int main(int argc, char *argv[])
 			auto reservedData = IntToLEVector<uint32_t>(0);
 
 			if (numberOfLoops)
-				GetTime(ncsfFilename, &finalSDAT, finalSDAT.infoSection.SEQrecord.entries[0].sseq, tags, !!options[VERBOSE], numberOfLoops, fadeLoop, fadeOneShot);
+				GetTime(ncsfFilename, &finalSDAT, finalSDAT.infoSection.SEQrecord.entries[0].sseq, tags, !!options[VERBOSE], numberOfLoops, fadeLoop, fadeOneShot, !!options[REPLAYGAIN], loopSampleRate);
 
-			MakeNCSF(dirName + "/" + ncsfFilename, reservedData, sdatData.vector->data, tags.GetTags());
-			if (options[VERBOSE])
-				std::cout << "Created " << ncsfFilename << "\n";
+			writer.Add(dirName + "/" + ncsfFilename, reservedData, sdatData, tags.GetTags());
 		}
 		else
 		{
@@ -558,9 +773,7 @@ int main(int argc, char *argv[])
 
 			// Make NCSFLIB
 			std::string ncsflibFilename = gameSerial + ".ncsflib";
-			MakeNCSF(dirName + "/" + ncsflibFilename, std::vector<uint8_t>(), sdatData.vector->data);
-			if (options[VERBOSE])
-				std::cout << "Created " << ncsflibFilename << "\n";
+			writer.Add(dirName + "/" + ncsflibFilename, std::vector<uint8_t>(), sdatData);
 
 			// Make multiple MININCSFs
 			TagList tags;
@@ -597,6 +810,8 @@ int main(int argc, char *argv[])
 
 				if (sdatNumber > 1)
 					thisTags["origSDAT"] = finalSDAT.infoSection.SEQrecord.entries[i].sdatNumber;
+				if (sdatPaths.count(finalSDAT.infoSection.SEQrecord.entries[i].sdatNumber))
+					thisTags["origSDATFile"] = sdatPaths[finalSDAT.infoSection.SEQrecord.entries[i].sdatNumber];
 
 				// If this file was renamed from the generated name, then use the new filename instead
 				// (This will only work if there was a SYMB section in the SDAT)
@@ -604,13 +819,13 @@ int main(int argc, char *argv[])
 					minincsfFilename = filenames[fullFilename];
 
 				if (numberOfLoops)
-					GetTime(minincsfFilename, &finalSDAT, finalSDAT.infoSection.SEQrecord.entries[i].sseq, thisTags, !!options[VERBOSE], numberOfLoops, fadeLoop, fadeOneShot);
+					GetTime(minincsfFilename, &finalSDAT, finalSDAT.infoSection.SEQrecord.entries[i].sseq, thisTags, !!options[VERBOSE], numberOfLoops, fadeLoop, fadeOneShot, !!options[REPLAYGAIN], loopSampleRate);
 
-				MakeNCSF(dirName + "/" + minincsfFilename, reservedData, std::vector<uint8_t>(), thisTags.GetTags());
-				if (options[VERBOSE])
-					std::cout << "Created " << minincsfFilename << "\n";
+				writer.Add(dirName + "/" + minincsfFilename, reservedData, thisTags.GetTags());
 			}
 		}
+		// The files in the directory are left alone when writing a zip archive
+		writer.Finish(options[ZIP] ? Files() : previousFiles);
 	}
 	catch (const std::exception &e)
 	{
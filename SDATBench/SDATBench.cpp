@@ -0,0 +1,173 @@
+/*
+ * SDAT Benchmark
+ * Last modification on 2026-10-16
+ *
+ * Times how long the common code takes to parse and write an SDAT, so that
+ * changes to the readers and writers can be measured against the same input.
+ * It is built with "make bench" and is not one of the tools.
+ *
+ * Version history:
+ *   v1.0 - 2026-10-16 - Initial version
+ *   v1.1 - 2026-10-16 - Added the write mode.
+ */
+
+#include <iomanip>
+#include "SDAT.h"
+#ifdef _WIN32
+# include "windowsh_wrapper.h"
+#else
+# include <time.h>
+#endif
+
+static const std::string SDATBENCH_VERSION = "1.1";
+
+enum Options { UNKNOWN, HELP, ITERATIONS };
+const option::Descriptor opts[] =
+{
+	option::Descriptor(UNKNOWN, 0, "", "", option::Arg::None, "SDAT Benchmark v" + SDATBENCH_VERSION + "\n\n"
+		"SDAT Benchmark will time operations on the given SDAT, running each one many times and reporting the best and average times.\n\n"
+		"Usage:\n"
+		"  SDATBench [options] parse <Input SDAT filename>\n"
+		"  SDATBench [options] write <Input SDAT filename> <Output SDAT filename>\n\n"
+		"Modes:\n"
+		"  parse \tTime SDAT::Read on the SDAT, which has already been loaded into memory.\n"
+		"  write \tStrip the SDAT the same way as SDAT Strip, then time writing it to the output SDAT, both through a file stream and through a gather "
+			"list as SDAT Strip does.\n\n"
+		"Options:"),
+	option::Descriptor(HELP, 0, "h", "help", option::Arg::None, "  --help,-h \tPrint usage and exit."),
+	option::Descriptor(ITERATIONS, 0, "n", "iterations", RequireNumericArgument, "  --iterations,-n \tHow many times to run the operation, defaults to 1000."),
+	option::Descriptor()
+};
+
+// The current time in seconds, from a monotonic clock
+static double GetSeconds()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return static_cast<double>(counter.QuadPart) / frequency.QuadPart;
+#else
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+#endif
+}
+
+// Runs the operation the given number of times, then prints the best and
+// average time of a single run, along with the throughput for the given
+// number of bytes handled by each run
+template<typename Operation> static void Time(const std::string &name, uint32_t iterations, uint64_t bytes, Operation operation)
+{
+	double best = -1, total = 0;
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		double start = GetSeconds();
+		operation();
+		double elapsed = GetSeconds() - start;
+		if (best < 0 || elapsed < best)
+			best = elapsed;
+		total += elapsed;
+	}
+	std::cout << name << ": best " << std::fixed << std::setprecision(2) << best * 1e6 << " us, average " << total / iterations * 1e6 << " us, "
+		<< bytes / best / 1e6 << " MB/s (" << iterations << " runs)\n";
+}
+
+static void BenchParse(const std::string &sdatFilename, uint32_t iterations)
+{
+	PseudoReadFile fileData(sdatFilename);
+	fileData.GetDataFromFile(sdatFilename);
+
+	Time("SDAT::Read", iterations, fileData.Size(), [&]()
+	{
+		fileData.pos = 0;
+		SDAT sdat;
+		sdat.Read(sdatFilename, fileData);
+	});
+}
+
+static void BenchWrite(const std::string &sdatFilename, const std::string &outputFilename, uint32_t iterations)
+{
+	PseudoReadFile fileData(sdatFilename);
+	fileData.GetDataFromFile(sdatFilename);
+
+	// Appended to an empty SDAT and stripped, exactly as SDAT Strip does
+	SDAT inputSDAT, sdat;
+	inputSDAT.Read(sdatFilename, fileData);
+	sdat += inputSDAT;
+	sdat.Strip(IncOrExc(), false);
+
+	// Both ways write the same data, so its size is only found once
+	uint64_t bytes;
+	{
+		GatherList sdatData;
+		sdat.Write(sdatData);
+		bytes = sdatData.Size();
+	}
+
+	Time("SDAT::Write to a file stream", iterations, bytes, [&]()
+	{
+		std::ofstream file;
+		file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+		file.open(outputFilename.c_str(), std::ofstream::out | std::ofstream::binary);
+		PseudoWrite ofile(&file);
+		sdat.Write(ofile);
+		ofile.Flush();
+	});
+
+	Time("SDAT::Write to a gather list", iterations, bytes, [&]()
+	{
+		GatherList sdatData;
+		sdat.Write(sdatData);
+		sdatData.WriteToFile(outputFilename);
+	});
+}
+
+int main(int argc, char *argv[])
+{
+	// Options parsing
+	argc -= argc > 0;
+	argv += argc > 0;
+	option::Stats stats(opts, argc, argv);
+	std::vector<option::Option> options(stats.options_max), buffer(stats.buffer_max);
+	option::Parser parse(opts, argc, argv, &options[0], &buffer[0]);
+
+	if (parse.error())
+		return 1;
+
+	if (options[HELP] || !argc || parse.nonOptionsCount() < 2)
+	{
+		option::printUsage(std::cout, opts);
+		return 0;
+	}
+
+	uint32_t iterations = 1000;
+	if (options[ITERATIONS])
+		iterations = std::max(convertTo<uint32_t>(options[ITERATIONS].arg), 1u);
+
+	try
+	{
+		std::string mode = parse.nonOption(0), sdatFilename = parse.nonOption(1);
+		std::replace(sdatFilename.begin(), sdatFilename.end(), '\\', '/');
+		if (!FileExists(sdatFilename))
+			throw std::runtime_error("File " + sdatFilename + " does not exist.");
+
+		if (mode == "parse")
+			BenchParse(sdatFilename, iterations);
+		else if (mode == "write")
+		{
+			if (parse.nonOptionsCount() < 3)
+				throw std::runtime_error("The write mode needs an output filename.");
+			BenchWrite(sdatFilename, parse.nonOption(2), iterations);
+		}
+		else
+			throw std::runtime_error("Unknown mode " + mode + ".");
+	}
+	catch (const std::exception &e)
+	{
+		std::cerr << "Error: " << e.what() << "\n";
+		return 1;
+	}
+
+	return 0;
+}
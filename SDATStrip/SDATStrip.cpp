@@ -1,7 +1,7 @@
 /*
  * SDAT Strip
  * By Naram Qashat (CyberBotX) [cyberbotx@cyberbotx.com]
- * Last modification on 2014-10-25
+ * Last modification on 2026-10-16
  *
  * NOTE: This version has been superceded by NDS to NCSF instead.
  *
@@ -12,12 +12,15 @@
  *                     - Copied NDS to NCSF's include/exclude handling to here.
  *   v1.2 - 2014-10-25 - Save the PLAYER blocks in the SDATs as opposed to
  *                       stripping them.
+ *   v1.3 - 2026-10-16 - SDATs can be read directly from zip archives.
+ *                     - Gzipped SDATs can be read, and are scanned as they are
+ *                       inflated.
  */
 
 #include <map>
 #include "SDAT.h"
 
-static const std::string SDATSTRIP_VERSION = "1.2";
+static const std::string SDATSTRIP_VERSION = "1.3";
 
 enum { UNKNOWN, HELP, VERBOSE, FORCE, EXCLUDE, INCLUDE };
 const option::Descriptor opts[] =
@@ -27,7 +30,8 @@ const option::Descriptor opts[] =
 			"only SWARs used by the remaining SBNKs. SSARs and STRMs are not kept. Any gaps in the SYMB/INFO sections of the SDAT will also be removed.\n\n"
 		"Usage:\n"
 		"  SDATStrip [options] <Input SDAT filename> [...] <Output SDAT filename>\n"
-		"  (More than one input file can be given, they will be merged into the output.)\n\n"
+		"  (More than one input file can be given, they will be merged into the output. An input can also be a zip archive, given as\n"
+		"  <archive>.zip:<SDAT filename> or just <archive>.zip if it holds a single SDAT, or a gzipped SDAT.)\n\n"
 		"Options:"),
 	option::Descriptor(HELP, 0, "h", "help", option::Arg::None, "  --help,-h \tPrint usage and exit."),
 	option::Descriptor(VERBOSE, 0, "v", "verbose", option::Arg::None, "  --verbose,-v \tVerbose output."),
@@ -92,11 +96,20 @@ int main(int argc, char *argv[])
 
 		try
 		{
-			if (!FileExists(inputFilenames[i]))
+			std::string archiveFilename, memberFilename;
+			bool inArchive = SplitArchivePath(inputFilenames[i], archiveFilename, memberFilename);
+			if (!FileExists(inArchive ? archiveFilename : inputFilenames[i]))
 				throw std::runtime_error("File does not exist.");
 
-			PseudoReadFile fileData;
-			fileData.GetDataFromFile(inputFilenames[i]);
+			PseudoReadFile fileData(inputFilenames[i]);
+			if (inArchive)
+			{
+				RangedFile sdatFile;
+				sdatFile.Open(inputFilenames[i], ".sdat");
+				fileData.GetDataFromFile(sdatFile, 0, static_cast<size_t>(sdatFile.Size()));
+			}
+			else
+				fileData.GetDataFromFile(inputFilenames[i]);
 
 			SDAT sdat;
 			sdat.Read(inputFilenames[i], fileData);
@@ -120,13 +133,11 @@ int main(int argc, char *argv[])
 	{
 		finalSDAT.Strip(includesAndExcludes, !!options[VERBOSE]);
 
-		std::ofstream file;
-		file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-		file.open(outputFilename.c_str(), std::ofstream::out | std::ofstream::binary);
-
-		PseudoWrite ofile(&file);
-
-		finalSDAT.Write(ofile);
+		// The files are written from where they are instead of being copied
+		// after the sections
+		GatherList sdatData;
+		finalSDAT.Write(sdatData);
+		sdatData.WriteToFile(outputFilename);
 		std::cout << "Output written to " << outputFilename << "\n";
 	}
 	catch (const std::exception &e)
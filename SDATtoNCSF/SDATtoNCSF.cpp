@@ -1,7 +1,7 @@
 /*
  * SDAT to NCSF
  * By Naram Qashat (CyberBotX) [cyberbotx@cyberbotx.com]
- * Last modification on 2014-12-08
+ * Last modification on 2026-10-16
  *
  * NOTE: This version has been superceded by NDS to NCSF instead.  It also lacks
  *       some of the features that are in NDS to NCSF.
@@ -13,27 +13,59 @@
  *   v1.2 - 2014-10-15 - Improved timing system by implementing the random,
  *                       variable, and conditional SSEQ commands.
  *   v1.3 - 2014-12-08 - Minor cleanup of PseudoReadFile to not use a pointer.
+ *   v1.4 - 2026-10-16 - Added an option to measure the loudness of each track
+ *                       while timing it and store it in ReplayGain tags.
+ *                     - Added an option to store the loop points of looping
+ *                       tracks in tags.
+ *                     - SDATs can be read directly from zip archives.
+ *                     - Gzipped SDATs can be read, and are scanned as they are
+ *                       inflated.
+ *                     - Added fast, default and max compression profiles for
+ *                       the NCSFs.
+ *                     - NCSFs from a previous run that would come out the same
+ *                       are left untouched, with an option to force rewriting
+ *                       them.
+ *                     - Added an option to write the NCSFs into a single zip
+ *                       archive.
  */
 
 #include "NCSF.h"
+#include "NCSFWriter.h"
 
-static const std::string SDATTONCSF_VERSION = "1.3.1";
+static const std::string SDATTONCSF_VERSION = "1.4";
 
-enum Options { UNKNOWN, HELP, VERBOSE, TIME, FADELOOP, FADEONESHOT, RENAME };
+enum Options { UNKNOWN, HELP, VERBOSE, TIME, FADELOOP, FADEONESHOT, REPLAYGAIN, LOOPTAGS, RENAME, COMPRESSION, FORCE, ZIP };
 const option::Descriptor opts[] =
 {
 	option::Descriptor(UNKNOWN, 0, "", "", option::Arg::None, "SDAT to NCSF v" + SDATTONCSF_VERSION + "\nBy Naram Qashat (CyberBotX) [cyberbotx@cyberbotx.com]\nand James Pelster (jpmac26 / CaptainSwag101)\n\n"
 		"SDAT to NCSF will take the incoming SDAT and create a series of NCSF files. If there is only a single SSEQ within the SDAT, then there will be a "
 			"single NCSF file. Otherwise, there will be an NCSFLIB and multiple MININCSFs.\n\n"
 		"Usage:\n"
-		"  SDATtoNCSF [options] <Input SDAT filename>\n\n"
+		"  SDATtoNCSF [options] <Input SDAT filename>\n"
+		"  (The input can also be a zip archive, given as <archive>.zip:<SDAT filename> or just <archive>.zip if it holds a single SDAT, or a\n"
+		"  gzipped SDAT.)\n\n"
 		"Options:"),
 	option::Descriptor(HELP, 0, "h", "help", option::Arg::None, "  --help,-h \tPrint usage and exit."),
 	option::Descriptor(VERBOSE, 0, "v", "verbose", option::Arg::None, "  --verbose,-v \tVerbose output."),
 	option::Descriptor(TIME, 0, "t", "time", RequireNumericArgument, "  --time,-t \tCalculate time on each track to the number of loops given. Defaults to 2 loops. 0 will disable timing."),
 	option::Descriptor(FADELOOP, 0, "l", "fade-loop", RequireNumericArgument, "  --fade-loop,-l \tSet the fade time for looping tracks, in seconds, defaults to 10."),
 	option::Descriptor(FADEONESHOT, 0, "o", "fade-one-shot", RequireNumericArgument, "  --fade-one-shot,-o \tSet the fade time for one-shot tracks, in seconds, defaults to 0."),
+	option::Descriptor(REPLAYGAIN, 0, "g", "replaygain", option::Arg::None,
+		"  --replaygain,-g \tMeasure the loudness of each track while timing it and store it in the replaygain_track_gain and replaygain_track_peak tags. "
+			"This is much slower than timing alone."),
+	option::Descriptor(LOOPTAGS, 0, "L", "loop-tags", RequireNumericArgument,
+		"  --loop-tags=<rate> \v            -L <rate> \tStore the loop points of looping tracks in the loop_start and loop_end tags, and in samples at the given "
+			"sample rate in the loop_start_samples and loop_end_samples tags."),
 	option::Descriptor(RENAME, 0, "r", "rename", option::Arg::None, "  --rename,-r \tPrepend the song number to miniNCSF filenames. Use this if multiple songs share the same filename."),
+	option::Descriptor(COMPRESSION, 0, "c", "compression", RequireArgument,
+		"  --compression=<profile> \v             -c <profile> \tHow hard to compress the NCSFs: fast (zlib level 1, for quick test runs), default (level 9) "
+			"or max (tries several zlib settings at once and keeps whichever is smallest, much slower). Verbose output shows the size and time for each file."),
+	option::Descriptor(FORCE, 0, "f", "force", option::Arg::None,
+		"  --force,-f \tRewrite every NCSF. Without this, files from a previous run that would come out the same are left untouched, whichever profile they were "
+			"compressed with."),
+	option::Descriptor(ZIP, 0, "z", "zip", option::Arg::None,
+		"  --zip,-z \tWrite the NCSFs into a single zip archive named after the output directory, instead of into the directory. The NCSFs are stored in it "
+			"uncompressed, as they are already compressed."),
 	option::Descriptor(UNKNOWN, 0, "", "", option::Arg::None, "\nVerbose output will output the NCSFs created.\n\nTiming uses code based on FeOS Sound System by fincs."),
 	option::Descriptor()
 };
@@ -65,6 +97,15 @@ int main(int argc, char *argv[])
 	uint32_t fadeOneShot = 1;
 	if (options[FADEONESHOT])
 		fadeOneShot = convertTo<uint32_t>(options[FADEONESHOT].arg);
+	uint32_t loopSampleRate = 0;
+	if (options[LOOPTAGS])
+		loopSampleRate = convertTo<uint32_t>(options[LOOPTAGS].arg);
+	Compression compression = COMPRESSION_DEFAULT;
+	if (options[COMPRESSION] && !GetCompressionFromName(options[COMPRESSION].arg, compression))
+	{
+		std::cerr << "Error: Unknown compression profile " << options[COMPRESSION].arg << ".\n";
+		return 1;
+	}
 
 	try
 	{
@@ -72,26 +113,45 @@ int main(int argc, char *argv[])
 		std::string sdatFilename = parse.nonOption(0);
 		std::replace(sdatFilename.begin(), sdatFilename.end(), '\\', '/');
 
-		if (!FileExists(sdatFilename))
-			throw std::runtime_error("File " + sdatFilename + " does not exist.");
+		std::string archiveFilename, memberFilename;
+		bool inArchive = SplitArchivePath(sdatFilename, archiveFilename, memberFilename);
+		if (!FileExists(inArchive ? archiveFilename : sdatFilename))
+			throw std::runtime_error("File " + (inArchive ? archiveFilename : sdatFilename) + " does not exist.");
 
-		PseudoReadFile fileData;
-		fileData.GetDataFromFile(sdatFilename);
+		PseudoReadFile fileData(sdatFilename);
+		if (inArchive)
+		{
+			RangedFile sdatFile;
+			sdatFile.Open(sdatFilename, ".sdat");
+			fileData.GetDataFromFile(sdatFile, 0, static_cast<size_t>(sdatFile.Size()));
+		}
+		else
+			fileData.GetDataFromFile(sdatFilename);
 
 		// Create output directory
-		std::string dirName = sdatFilename;
+		std::string dirName = GetArchiveOutputPath(sdatFilename);
 		size_t dot = dirName.rfind('.');
 		dirName = dirName.substr(0, dot) + "_SDATtoNCSF";
+		std::string zipFilename = dirName + ".zip";
 
-		if (!DirExists(dirName))
+		if (!options[ZIP] && !DirExists(dirName))
 			MakeDir(dirName);
 		if (options[VERBOSE])
-			std::cout << "Output will go to " << dirName << "\n";
+			std::cout << "Output will go to " << (options[ZIP] ? zipFilename : dirName) << "\n";
 
 		// Parse SDAT
 		SDAT sdat;
 		sdat.Read(sdatFilename, fileData);
 
+		GatherList sdatData;
+		sdatData.Reference(fileData.data);
+		// The files are compressed and written while the next track is timed,
+		// and files that would come out the same are left alone, unless told
+		// to rewrite them all
+		NCSFWriter writer(!!options[VERBOSE], compression, !options[FORCE]);
+		if (options[ZIP])
+			writer.OpenArchive(zipFilename);
+
 		if (sdat.infoSection.SEQrecord.entries.size() == 1)
 		{
 			// Make single NCSF
@@ -102,21 +162,17 @@ int main(int argc, char *argv[])
 			auto reservedData = IntToLEVector<uint32_t>(0);
 
 			if (numberOfLoops)
-				GetTime(ncsfFilename, &sdat, sdat.infoSection.SEQrecord.entries[0].sseq, tags, !!options[VERBOSE], numberOfLoops, fadeLoop, fadeOneShot);
+				GetTime(ncsfFilename, &sdat, sdat.infoSection.SEQrecord.entries[0].sseq, tags, !!options[VERBOSE], numberOfLoops, fadeLoop, fadeOneShot, !!options[REPLAYGAIN], loopSampleRate);
 
-			MakeNCSF(dirName + "/" + ncsfFilename, reservedData, fileData.data, tags.GetTags());
-			if (options[VERBOSE])
-				std::cout << "Created " << ncsfFilename << "\n";
+			writer.Add(dirName + "/" + ncsfFilename, reservedData, sdatData, tags.GetTags());
 		}
 		else
 		{
 			// Make NCSFLIB
-			std::string ncsflibFilename = GetFilenameFromPath(sdatFilename);
+			std::string ncsflibFilename = GetFilenameFromPath(GetArchiveOutputPath(sdatFilename));
 			size_t libdot = ncsflibFilename.rfind('.');
 			ncsflibFilename = ncsflibFilename.substr(0, libdot) + ".ncsflib";
-			MakeNCSF(dirName + "/" + ncsflibFilename, std::vector<uint8_t>(), fileData.data);
-			if (options[VERBOSE])
-				std::cout << "Created " << ncsflibFilename << "\n";
+			writer.Add(dirName + "/" + ncsflibFilename, std::vector<uint8_t>(), sdatData);
 
 			// Make multiple MININCSFs
 			TagList tags;
@@ -140,13 +196,12 @@ int main(int argc, char *argv[])
 					thisTags["origFilename"] = sdat.infoSection.SEQrecord.entries[i].sseq->origFilename;
 
 				if (numberOfLoops)
-					GetTime(minincsfFilename, &sdat, sdat.infoSection.SEQrecord.entries[i].sseq, thisTags, !!options[VERBOSE], numberOfLoops, fadeLoop, fadeOneShot);
+					GetTime(minincsfFilename, &sdat, sdat.infoSection.SEQrecord.entries[i].sseq, thisTags, !!options[VERBOSE], numberOfLoops, fadeLoop, fadeOneShot, !!options[REPLAYGAIN], loopSampleRate);
 
-				MakeNCSF(dirName + "/" + minincsfFilename, reservedData, std::vector<uint8_t>(), thisTags.GetTags());
-				if (options[VERBOSE])
-					std::cout << "Created " << minincsfFilename << "\n";
+				writer.Add(dirName + "/" + minincsfFilename, reservedData, thisTags.GetTags());
 			}
 		}
+		writer.Finish();
 	}
 	catch (const std::exception &e)
 	{
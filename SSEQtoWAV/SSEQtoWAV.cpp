@@ -0,0 +1,374 @@
+/*
+ * SSEQ to WAV
+ * Last modification on 2026-10-16
+ *
+ * Renders the SSEQs within an SDAT, or an NCSF set, to WAV files, using the
+ * same player that is used for timing.
+ *
+ * Version history:
+ *   v1.0 - 2026-10-16 - Initial version
+ *   v1.1 - 2026-10-16 - Added linear, cubic and sinc interpolation, defaulting
+ *                       to sinc.
+ */
+
+#include <map>
+#include "NCSF.h"
+#include "TimerPlayer.h"
+#include "ThreadPool.h"
+
+static const std::string SSEQTOWAV_VERSION = "1.1";
+
+enum Options { UNKNOWN, HELP, VERBOSE, RATE, INTERPOLATION, THREADS, TIME, FADELOOP, FADEONESHOT };
+const option::Descriptor opts[] =
+{
+	option::Descriptor(UNKNOWN, 0, "", "", option::Arg::None, "SSEQ to WAV v" + SSEQTOWAV_VERSION + "\n\n"
+		"SSEQ to WAV will take the incoming SDAT, NCSF/MININCSF files, or directories containing NCSF sets, and render each SSEQ within them to a WAV file. "
+			"The length and fade tags of the NCSFs are used when they exist, otherwise the SSEQs will be timed first.\n\n"
+		"Usage:\n"
+		"  SSEQtoWAV [options] <Input SDAT, NCSF or directory> [<Input SDAT, NCSF or directory> ...]\n\n"
+		"Options:"),
+	option::Descriptor(HELP, 0, "h", "help", option::Arg::None, "  --help,-h \tPrint usage and exit."),
+	option::Descriptor(VERBOSE, 0, "v", "verbose", option::Arg::None, "  --verbose,-v \tVerbose output."),
+	option::Descriptor(RATE, 0, "r", "rate", RequireNumericArgument, "  --rate,-r \tSample rate to render at, defaults to 44100."),
+	option::Descriptor(INTERPOLATION, 0, "i", "interpolation", RequireArgument,
+		"  --interpolation,-i \tHow samples are interpolated, one of none, linear, cubic or sinc. Defaults to sinc."),
+	option::Descriptor(THREADS, 0, "j", "threads", RequireNumericArgument, "  --threads,-j \tNumber of tracks to render at once, defaults to the number of processors."),
+	option::Descriptor(TIME, 0, "t", "time", RequireNumericArgument, "  --time,-t \tNumber of loops to time untimed tracks to. Defaults to 2 loops."),
+	option::Descriptor(FADELOOP, 0, "l", "fade-loop", RequireNumericArgument, "  --fade-loop,-l \tSet the fade time for untimed looping tracks, in seconds, defaults to 10."),
+	option::Descriptor(FADEONESHOT, 0, "o", "fade-one-shot", RequireNumericArgument, "  --fade-one-shot,-o \tSet the fade time for untimed one-shot tracks, in seconds, defaults to 0."),
+	option::Descriptor(UNKNOWN, 0, "", "", option::Arg::None, "\nAn SDAT will be rendered into a directory next to it, NCSFs will be rendered to WAV files next to them.\n\n"
+		"Verbose output will output the WAVs created.\n\nPlayback uses code based on FeOS Sound System by fincs."),
+	option::Descriptor()
+};
+
+// Number of stereo frames to render before writing them out
+static const uint32_t RENDERBLOCKFRAMES = 4096;
+
+struct RenderJob
+{
+	std::string name, wavFilename;
+	std::shared_ptr<SDAT> sdat;
+	const SSEQ *sseq;
+	TagList tags;
+
+	RenderJob(const std::string &newName = "", const std::string &newWavFilename = "", const std::shared_ptr<SDAT> &newSDAT = std::shared_ptr<SDAT>(),
+		const SSEQ *newSSEQ = nullptr, const TagList &newTags = TagList()) : name(newName), wavFilename(newWavFilename), sdat(newSDAT), sseq(newSSEQ),
+		tags(newTags)
+	{
+	}
+};
+
+typedef std::vector<RenderJob> RenderJobs;
+
+static void WriteWAVHeader(PseudoWrite &ofile, uint32_t sampleRate, uint32_t frames)
+{
+	uint32_t dataSize = frames * 4;
+	ofile.WriteLE("RIFF", 4);
+	ofile.WriteLE<uint32_t>(36 + dataSize);
+	ofile.WriteLE("WAVE", 4);
+	ofile.WriteLE("fmt ", 4);
+	ofile.WriteLE<uint32_t>(16);
+	ofile.WriteLE<uint16_t>(1); // PCM
+	ofile.WriteLE<uint16_t>(2); // Stereo
+	ofile.WriteLE(sampleRate);
+	ofile.WriteLE<uint32_t>(sampleRate * 4);
+	ofile.WriteLE<uint16_t>(4);
+	ofile.WriteLE<uint16_t>(16);
+	ofile.WriteLE("data", 4);
+	ofile.WriteLE(dataSize);
+}
+
+// Render the SSEQ of the given job, a block at a time, fading out after the length.
+// The WAV is removed again if anything goes wrong while writing it.
+static void RenderSSEQ(const RenderJob &job, uint32_t sampleRate, Interpolation interpolation, double length, double fade)
+{
+	// The size of the RIFF chunk is 32-bit, so it has to be checked before any frames are rendered
+	uint64_t lengthFrames64 = static_cast<uint64_t>(length * sampleRate), fadeFrames64 = static_cast<uint64_t>(fade * sampleRate);
+	if (36 + (lengthFrames64 + fadeFrames64) * 4 > 0xFFFFFFFF)
+		throw std::runtime_error("The WAV would be larger than the 4 GB a WAV file can hold, use a lower sample rate.");
+	uint32_t lengthFrames = static_cast<uint32_t>(lengthFrames64), fadeFrames = static_cast<uint32_t>(fadeFrames64);
+	uint32_t totalFrames = lengthFrames + fadeFrames;
+
+	auto player = std::unique_ptr<TimerPlayer>(new TimerPlayer());
+	SetupPlayerForNotes(player.get(), job.sdat.get(), job.sseq);
+	player->SetupRender(sampleRate, interpolation);
+
+	std::ofstream file;
+	file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+	file.open(job.wavFilename.c_str(), std::ofstream::out | std::ofstream::binary);
+
+	try
+	{
+		PseudoWrite ofile(&file);
+		WriteWAVHeader(ofile, sampleRate, totalFrames);
+
+		auto samples = std::vector<int16_t>(RENDERBLOCKFRAMES * 2);
+		PseudoWriteVector blockData;
+		for (uint32_t frame = 0; frame < totalFrames; frame += RENDERBLOCKFRAMES)
+		{
+			uint32_t frames = std::min(RENDERBLOCKFRAMES, totalFrames - frame);
+			player->Render(&samples[0], frames);
+
+			for (uint32_t i = 0; i < frames; ++i)
+			{
+				int16_t left = samples[i * 2], right = samples[i * 2 + 1];
+				if (frame + i >= lengthFrames)
+				{
+					double scale = static_cast<double>(totalFrames - (frame + i)) / fadeFrames;
+					left = static_cast<int16_t>(left * scale);
+					right = static_cast<int16_t>(right * scale);
+				}
+				blockData.WriteLE(left);
+				blockData.WriteLE(right);
+			}
+
+			ofile.WriteLE(blockData.data);
+			blockData.data.clear();
+		}
+
+		ofile.Flush();
+		file.close();
+	}
+	catch (...)
+	{
+		file.exceptions(std::ofstream::goodbit);
+		file.close();
+		remove(job.wavFilename.c_str());
+		throw;
+	}
+}
+
+// Get the SDAT from the given NCSF's program section, or from the NCSFLIB given by the _lib tag
+static std::shared_ptr<SDAT> GetSDATFromNCSF(const std::string &filename, PseudoReadFile &fileData, const TagList &tags,
+	std::map<std::string, std::shared_ptr<SDAT>> &libs)
+{
+	auto sdatVector = GetProgramSectionFromPSF(fileData, 0x25, 12, 8);
+	if (sdatVector.empty())
+	{
+		if (!tags.Exists("_lib"))
+			throw std::runtime_error("NCSF has no program section and no _lib tag.");
+
+		std::string libFilename = tags["_lib"];
+		size_t lastSlash = filename.rfind('/');
+		if (lastSlash != std::string::npos)
+			libFilename = filename.substr(0, lastSlash + 1) + libFilename;
+
+		auto lib = libs.find(libFilename);
+		if (lib != libs.end())
+			return lib->second;
+
+		PseudoReadFile libFileData;
+		libFileData.GetDataFromFile(libFilename);
+		TagList libTags = GetTagsFromPSF(libFileData, 0x25);
+		auto sdat = GetSDATFromNCSF(libFilename, libFileData, libTags, libs);
+		libs[libFilename] = sdat;
+		return sdat;
+	}
+
+	PseudoReadFile sdatFileData(filename);
+	sdatFileData.ViewData(sdatVector);
+
+	auto sdat = std::make_shared<SDAT>();
+	sdat->Read(filename, sdatFileData);
+	return sdat;
+}
+
+// Add a job for the SSEQ of the given NCSF, which has already been loaded, the SSEQ number coming from the reserved section
+static void AddNCSFJob(const std::string &filename, PseudoReadFile &fileData, RenderJobs &jobs, std::map<std::string, std::shared_ptr<SDAT>> &libs)
+{
+	TagList tags = GetTagsFromPSF(fileData, 0x25);
+	auto sdat = GetSDATFromNCSF(filename, fileData, tags, libs);
+
+	fileData.pos = 4;
+	uint32_t reservedSize = fileData.ReadLE<uint32_t>();
+	uint32_t SSEQNumber = 0;
+	if (reservedSize >= 4)
+	{
+		fileData.pos = 16;
+		SSEQNumber = fileData.ReadLE<uint32_t>();
+	}
+
+	const auto &record = sdat->infoSection.SEQrecord;
+	if (SSEQNumber >= record.count || !record.entryOffsets[SSEQNumber] || !record.entries[SSEQNumber].sseq)
+		throw std::runtime_error("SSEQ #" + stringify(SSEQNumber) + " does not exist in the SDAT.");
+
+	size_t dot = filename.rfind('.');
+	std::string name = GetFilenameFromPath(filename);
+	jobs.push_back(RenderJob(name, filename.substr(0, dot) + ".wav", sdat, record.entries[SSEQNumber].sseq, tags));
+}
+
+// Add a job for every SSEQ within the given SDAT, which has already been loaded
+static void AddSDATJobs(const std::string &filename, PseudoReadFile &fileData, RenderJobs &jobs, bool verbose)
+{
+	auto sdat = std::make_shared<SDAT>();
+	sdat->Read(filename, fileData);
+
+	std::string dirName = filename;
+	size_t dot = dirName.rfind('.');
+	dirName = dirName.substr(0, dot) + "_SSEQtoWAV";
+
+	if (!DirExists(dirName))
+		MakeDir(dirName);
+	if (verbose)
+		std::cout << "Output will go to " << dirName << "\n";
+
+	const auto &record = sdat->infoSection.SEQrecord;
+	for (size_t i = 0; i < record.count; ++i)
+	{
+		if (!record.entryOffsets[i] || !record.entries[i].sseq)
+			continue;
+		const SSEQ *sseq = record.entries[i].sseq;
+		jobs.push_back(RenderJob(sseq->filename, dirName + "/" + sseq->filename + ".wav", sdat, sseq));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	// Options parsing
+	argc -= argc > 0;
+	argv += argc > 0;
+	option::Stats stats(opts, argc, argv);
+	std::vector<option::Option> options(stats.options_max), buffer(stats.buffer_max);
+	option::Parser parse(opts, argc, argv, &options[0], &buffer[0]);
+
+	if (parse.error())
+		return 1;
+
+	if (options[HELP] || !argc || parse.nonOptionsCount() < 1)
+	{
+		option::printUsage(std::cout, opts);
+		return 0;
+	}
+
+	uint32_t sampleRate = 44100;
+	if (options[RATE])
+		sampleRate = convertTo<uint32_t>(options[RATE].arg);
+	Interpolation interpolation = INTERPOLATION_SINC;
+	if (options[INTERPOLATION])
+	{
+		std::string interpolationName = options[INTERPOLATION].arg;
+		std::transform(interpolationName.begin(), interpolationName.end(), interpolationName.begin(), ::tolower);
+		if (interpolationName == "none")
+			interpolation = INTERPOLATION_NONE;
+		else if (interpolationName == "linear")
+			interpolation = INTERPOLATION_LINEAR;
+		else if (interpolationName == "cubic")
+			interpolation = INTERPOLATION_CUBIC;
+		else if (interpolationName != "sinc")
+		{
+			std::cerr << "Error: Unknown interpolation " << options[INTERPOLATION].arg << ".\n";
+			return 1;
+		}
+	}
+	uint32_t threadCount = 0;
+	if (options[THREADS])
+		threadCount = convertTo<uint32_t>(options[THREADS].arg);
+	uint32_t numberOfLoops = 2;
+	if (options[TIME])
+		numberOfLoops = convertTo<uint32_t>(options[TIME].arg);
+	uint32_t fadeLoop = 10;
+	if (options[FADELOOP])
+		fadeLoop = convertTo<uint32_t>(options[FADELOOP].arg);
+	uint32_t fadeOneShot = 0;
+	if (options[FADEONESHOT])
+		fadeOneShot = convertTo<uint32_t>(options[FADEONESHOT].arg);
+
+	if (!sampleRate)
+	{
+		std::cerr << "Error: The sample rate must be greater than 0.\n";
+		return 1;
+	}
+	if (!numberOfLoops)
+		numberOfLoops = 1;
+
+	bool verbose = !!options[VERBOSE];
+	bool failed = false;
+
+	// Gather up everything that needs to be rendered
+	RenderJobs jobs;
+	std::map<std::string, std::shared_ptr<SDAT>> libs;
+	for (int i = 0, count = parse.nonOptionsCount(); i < count; ++i)
+	{
+		std::string inputFilename = parse.nonOption(i);
+		std::replace(inputFilename.begin(), inputFilename.end(), '\\', '/');
+
+		try
+		{
+			if (DirExists(inputFilename))
+			{
+				std::string extensions[] = { ".ncsf", ".minincsf" };
+				auto extensionsVector = std::vector<std::string>(extensions, extensions + 2);
+				Files files = GetFilesInDirectory(inputFilename, extensionsVector);
+				std::sort(files.begin(), files.end());
+				std::for_each(files.begin(), files.end(), [&](const std::string &filename)
+				{
+					try
+					{
+						PseudoReadFile fileData;
+						fileData.GetDataFromFile(filename);
+						AddNCSFJob(filename, fileData, jobs, libs);
+					}
+					catch (const std::exception &e)
+					{
+						std::cerr << "Error with " << filename << ": " << e.what() << "\n";
+						failed = true;
+					}
+				});
+			}
+			else
+			{
+				if (!FileExists(inputFilename))
+					throw std::runtime_error("File " + inputFilename + " does not exist.");
+
+				// The input is only loaded once, and handed to whichever kind of file its magic says it is
+				PseudoReadFile fileData;
+				fileData.GetDataFromFile(inputFilename);
+				if (fileData.Size() >= 4 && !memcmp(fileData.Data(), "SDAT", 4))
+					AddSDATJobs(inputFilename, fileData, jobs, verbose);
+				else
+					AddNCSFJob(inputFilename, fileData, jobs, libs);
+			}
+		}
+		catch (const std::exception &e)
+		{
+			std::cerr << "Error with " << inputFilename << ": " << e.what() << "\n";
+			failed = true;
+		}
+	}
+
+	// Render the tracks, several at a time
+	Mutex outputMutex;
+	ThreadPool pool(threadCount);
+	std::for_each(jobs.begin(), jobs.end(), [&](RenderJob &job)
+	{
+		pool.Enqueue([&]()
+		{
+			try
+			{
+				if (!job.tags.Exists("length"))
+					GetTime(job.name, job.sdat.get(), job.sseq, job.tags, false, numberOfLoops, fadeLoop, fadeOneShot);
+				if (!job.tags.Exists("length"))
+					throw std::runtime_error("Unable to calculate time.");
+
+				double length = StringToSeconds(job.tags["length"]);
+				double fade = job.tags.Exists("fade") ? StringToSeconds(job.tags["fade"]) : 0;
+				RenderSSEQ(job, sampleRate, interpolation, length, fade);
+
+				if (verbose)
+				{
+					MutexLocker lock(outputMutex);
+					std::cout << "Created " << job.wavFilename << " (" << job.tags["length"] << " + " << fade << "s fade)\n";
+				}
+			}
+			catch (const std::exception &e)
+			{
+				MutexLocker lock(outputMutex);
+				std::cerr << "Error with " << job.name << ": " << e.what() << "\n";
+				failed = true;
+			}
+		});
+	});
+	pool.Wait();
+
+	return failed ? 1 : 0;
+}
@@ -13,12 +13,11 @@ FATRecord::FATRecord() : offset(0), size(0)
 {
 }
 
-void FATRecord::Read(PseudoReadFile &file)
+void FATRecord::Read(CheckedRegion &region)
 {
-	this->offset = file.ReadLE<uint32_t>();
-	this->size = file.ReadLE<uint32_t>();
-	uint32_t reserved[2];
-	file.ReadLE(reserved);
+	this->offset = region.ReadLE<uint32_t>();
+	this->size = region.ReadLE<uint32_t>();
+	region.Skip(8); // reserved
 }
 
 void FATRecord::Write(PseudoWrite &file) const
@@ -36,14 +35,16 @@ FATSection::FATSection() : size(0), count(0), records()
 
 void FATSection::Read(PseudoReadFile &file)
 {
-	file.ReadLE(this->type);
+	auto header = file.CheckRegion(12);
+	header.ReadLE(this->type);
 	if (!VerifyHeader(this->type, "FAT "))
 		throw std::runtime_error("SDAT FAT Section invalid");
-	this->size = file.ReadLE<uint32_t>();
-	this->count = file.ReadLE<uint32_t>();
+	this->size = header.ReadLE<uint32_t>();
+	this->count = header.ReadLE<uint32_t>();
+	auto table = file.CheckRegion(this->count, 16);
 	this->records.resize(this->count);
 	for (uint32_t i = 0; i < this->count; ++i)
-		this->records[i].Read(file);
+		this->records[i].Read(table);
 }
 
 uint32_t FATSection::Size() const
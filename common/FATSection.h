@@ -18,7 +18,7 @@ struct FATRecord
 
 	FATRecord();
 
-	void Read(PseudoReadFile &file);
+	void Read(CheckedRegion &region);
 	void Write(PseudoWrite &file) const;
 };
 
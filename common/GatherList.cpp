@@ -0,0 +1,99 @@
+/*
+ * SDAT - Gather list structure
+ * Last modification on 2026-10-16
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <fstream>
+#include "GatherList.h"
+#ifndef _WIN32
+# include <climits>
+# include <cerrno>
+# include <sys/uio.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+#undef min
+#undef max
+
+#if !defined(_WIN32) && !defined(IOV_MAX)
+# define IOV_MAX 1024
+#endif
+
+GatherList::GatherList() : head(), payloads()
+{
+}
+
+void GatherList::Reference(const std::vector<uint8_t> &data)
+{
+	if (!data.empty())
+		this->payloads.push_back(Segment(&data[0], data.size()));
+}
+
+uint64_t GatherList::Size() const
+{
+	uint64_t size = this->head.vector->data.size();
+	std::for_each(this->payloads.begin(), this->payloads.end(), [&](const Segment &payload) { size += payload.size; });
+	return size;
+}
+
+std::vector<GatherList::Segment> GatherList::Segments() const
+{
+	std::vector<Segment> segments;
+	segments.reserve(this->payloads.size() + 1);
+	const auto &headData = this->head.vector->data;
+	if (!headData.empty())
+		segments.push_back(Segment(&headData[0], headData.size()));
+	segments.insert(segments.end(), this->payloads.begin(), this->payloads.end());
+	return segments;
+}
+
+void GatherList::WriteToFile(const std::string &filename) const
+{
+	auto segments = this->Segments();
+#ifdef _WIN32
+	std::ofstream file;
+	file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+	file.open(filename.c_str(), std::ofstream::out | std::ofstream::binary);
+	std::for_each(segments.begin(), segments.end(), [&](const Segment &segment) { file.write(reinterpret_cast<const char *>(segment.data), segment.size); });
+	file.close();
+#else
+	int file = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (file == -1)
+		throw std::runtime_error("Unable to open " + filename + " for writing.");
+
+	// Each call takes up to IOV_MAX segments, and a short write only moves
+	// the start of the first segment that was not completely written
+	std::vector<iovec> iov(segments.size());
+	for (size_t i = 0; i < segments.size(); ++i)
+	{
+		iov[i].iov_base = const_cast<uint8_t *>(segments[i].data);
+		iov[i].iov_len = segments[i].size;
+	}
+	size_t first = 0;
+	while (first < iov.size())
+	{
+		int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+		ssize_t written = writev(file, &iov[first], count);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			close(file);
+			throw std::runtime_error("Unable to write to " + filename + ".");
+		}
+		size_t remaining = static_cast<size_t>(written);
+		while (first < iov.size() && remaining >= iov[first].iov_len)
+			remaining -= iov[first++].iov_len;
+		if (remaining)
+		{
+			iov[first].iov_base = static_cast<uint8_t *>(iov[first].iov_base) + remaining;
+			iov[first].iov_len -= remaining;
+		}
+	}
+	if (close(file))
+		throw std::runtime_error("Unable to write to " + filename + ".");
+#endif
+}
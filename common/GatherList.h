@@ -0,0 +1,49 @@
+/*
+ * SDAT - Gather list structure
+ * Last modification on 2026-10-16
+ *
+ * A serialized structure is held as a small buffer with its headers followed
+ * by references to payloads that are already in memory elsewhere, such as
+ * the files within an SDAT.  The whole can then be written out with writev or
+ * fed to deflate a piece at a time without being copied together first.  The
+ * referenced payloads must outlive the list.
+ */
+
+#pragma once
+
+#include "common.h"
+
+struct GatherList
+{
+	struct Segment
+	{
+		const uint8_t *data;
+		size_t size;
+
+		Segment(const uint8_t *segmentData = nullptr, size_t segmentSize = 0) : data(segmentData), size(segmentSize)
+		{
+		}
+	};
+
+	PseudoWrite head;
+
+	GatherList();
+
+	// Adds a reference to the given data after everything added so far
+	void Reference(const std::vector<uint8_t> &data);
+
+	// The total size of the head and all the referenced payloads
+	uint64_t Size() const;
+	// The head followed by the referenced payloads, leaving out empty ones
+	std::vector<Segment> Segments() const;
+
+	// Writes everything out to the given file, throwing an exception if the
+	// file could not be written
+	void WriteToFile(const std::string &filename) const;
+
+private:
+	std::vector<Segment> payloads;
+
+	GatherList(const GatherList &);
+	GatherList &operator=(const GatherList &);
+};
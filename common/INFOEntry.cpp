@@ -67,14 +67,15 @@ INFOEntrySEQ &INFOEntrySEQ::operator=(const INFOEntrySEQ &entry)
 
 void INFOEntrySEQ::Read(PseudoReadFile &file)
 {
-	this->fileID = file.ReadLE<uint16_t>();
-	this->unknown = file.ReadLE<uint16_t>();
-	this->bank = file.ReadLE<uint16_t>();
-	this->vol = file.ReadLE<uint8_t>();
-	this->cpr = file.ReadLE<uint8_t>();
-	this->ppr = file.ReadLE<uint8_t>();
-	this->ply = file.ReadLE<uint8_t>();
-	file.ReadLE(this->unknown2);
+	auto entry = file.CheckRegion(this->Size());
+	this->fileID = entry.ReadLE<uint16_t>();
+	this->unknown = entry.ReadLE<uint16_t>();
+	this->bank = entry.ReadLE<uint16_t>();
+	this->vol = entry.ReadLE<uint8_t>();
+	this->cpr = entry.ReadLE<uint8_t>();
+	this->ppr = entry.ReadLE<uint8_t>();
+	this->ply = entry.ReadLE<uint8_t>();
+	entry.ReadLE(this->unknown2);
 }
 
 uint32_t INFOEntrySEQ::Size() const
@@ -119,9 +120,10 @@ INFOEntryBANK &INFOEntryBANK::operator=(const INFOEntryBANK &entry)
 
 void INFOEntryBANK::Read(PseudoReadFile &file)
 {
-	this->fileID = file.ReadLE<uint16_t>();
-	this->unknown = file.ReadLE<uint16_t>();
-	file.ReadLE(this->waveArc);
+	auto entry = file.CheckRegion(this->Size());
+	this->fileID = entry.ReadLE<uint16_t>();
+	this->unknown = entry.ReadLE<uint16_t>();
+	entry.ReadLE(this->waveArc);
 }
 
 uint32_t INFOEntryBANK::Size() const
@@ -158,8 +160,9 @@ INFOEntryWAVEARC &INFOEntryWAVEARC::operator=(const INFOEntryWAVEARC &entry)
 
 void INFOEntryWAVEARC::Read(PseudoReadFile &file)
 {
-	this->fileID = file.ReadLE<uint16_t>();
-	this->unknown = file.ReadLE<uint16_t>();
+	auto entry = file.CheckRegion(this->Size());
+	this->fileID = entry.ReadLE<uint16_t>();
+	this->unknown = entry.ReadLE<uint16_t>();
 }
 
 uint32_t INFOEntryWAVEARC::Size() const
@@ -195,9 +198,10 @@ INFOEntryPLAYER &INFOEntryPLAYER::operator=(const INFOEntryPLAYER &entry)
 
 void INFOEntryPLAYER::Read(PseudoReadFile &file)
 {
-	this->maxSeqs = file.ReadLE<uint16_t>();
-	this->channelMask = file.ReadLE<uint16_t>();
-	this->heapSize = file.ReadLE<uint32_t>();
+	auto entry = file.CheckRegion(this->Size());
+	this->maxSeqs = entry.ReadLE<uint16_t>();
+	this->channelMask = entry.ReadLE<uint16_t>();
+	this->heapSize = entry.ReadLE<uint32_t>();
 }
 
 uint32_t INFOEntryPLAYER::Size() const
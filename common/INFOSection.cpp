@@ -16,8 +16,9 @@ template<typename T> INFORecord<T>::INFORecord() : count(0), actualCount(0), ent
 template<typename T> void INFORecord<T>::Read(PseudoReadFile &file, uint32_t startOffset)
 {
 	this->count = file.ReadLE<uint32_t>();
+	auto offsets = file.CheckRegion(this->count, 4);
 	this->entryOffsets.resize(this->count);
-	file.ReadLE(this->entryOffsets);
+	offsets.ReadLE(this->entryOffsets);
 	this->entries.resize(this->count);
 	for (uint32_t i = 0; i < this->count; ++i)
 		if (this->entryOffsets[i])
@@ -67,11 +68,12 @@ INFOSection::INFOSection() : size(0), SEQrecord(), BANKrecord(), WAVEARCrecord()
 void INFOSection::Read(PseudoReadFile &file)
 {
 	uint32_t startOfINFO = file.pos;
-	file.ReadLE(this->type);
+	auto header = file.CheckRegion(8 + sizeof(this->recordOffsets));
+	header.ReadLE(this->type);
 	if (!VerifyHeader(this->type, "INFO"))
 		throw std::runtime_error("SDAT INFO Section invalid");
-	this->size = file.ReadLE<uint32_t>();
-	file.ReadLE(this->recordOffsets);
+	this->size = header.ReadLE<uint32_t>();
+	header.ReadLE(this->recordOffsets);
 	if (this->recordOffsets[REC_SEQ])
 	{
 		file.pos = startOfINFO + this->recordOffsets[REC_SEQ];
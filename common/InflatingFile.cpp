@@ -0,0 +1,147 @@
+/*
+ * SDAT - Inflating file structures
+ * Last modification on 2026-10-16
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+#include <zlib.h>
+#include "InflatingFile.h"
+
+#undef min
+#undef max
+
+// The window holds between one and two of these, so a step back of up to a
+// block is always served without inflating from the start again
+static const size_t INFLATE_BLOCK_SIZE = 1 << 20;
+
+InflatingFile::InflatingFile() : filename(""), size(0), window(), windowStart(0)
+{
+}
+
+InflatingFile::~InflatingFile()
+{
+}
+
+void InflatingFile::Read(uint64_t offset, size_t count, std::vector<uint8_t> &buffer)
+{
+	if (offset >= this->size)
+		count = 0;
+	else if (count > this->size - offset)
+		count = static_cast<size_t>(this->size - offset);
+	buffer.resize(count);
+
+	size_t done = 0;
+	while (done < count)
+	{
+		uint64_t position = offset + done;
+		if (position < this->windowStart)
+			this->Restart();
+		else if (position >= this->windowStart + this->window.size())
+			this->InflateBlock();
+		else
+		{
+			size_t windowOffset = static_cast<size_t>(position - this->windowStart);
+			size_t chunk = std::min(count - done, this->window.size() - windowOffset);
+			memcpy(&buffer[done], &this->window[windowOffset], chunk);
+			done += chunk;
+		}
+	}
+}
+
+void InflatingFile::Restart()
+{
+	this->ResetWindow();
+	if (!this->Rewind())
+		throw std::runtime_error("Unable to read " + this->filename + ".");
+}
+
+void InflatingFile::ResetWindow()
+{
+	this->window.clear();
+	this->windowStart = 0;
+}
+
+void InflatingFile::InflateBlock()
+{
+	if (this->window.size() > INFLATE_BLOCK_SIZE)
+	{
+		size_t drop = this->window.size() - INFLATE_BLOCK_SIZE;
+		this->window.erase(this->window.begin(), this->window.begin() + drop);
+		this->windowStart += drop;
+	}
+
+	size_t filled = this->window.size();
+	size_t end = filled + static_cast<size_t>(std::min<uint64_t>(INFLATE_BLOCK_SIZE, this->size - this->windowStart - filled));
+	this->window.resize(end);
+	while (filled < end)
+	{
+		int result = this->Inflate(&this->window[filled], static_cast<unsigned>(end - filled));
+		if (result <= 0)
+		{
+			this->window.resize(filled);
+			throw std::runtime_error("Unable to read " + this->filename + ".");
+		}
+		filled += result;
+	}
+}
+
+bool IsGzipFile(const std::string &filename)
+{
+	std::ifstream file(filename.c_str(), std::ifstream::in | std::ifstream::binary);
+	unsigned char magic[2] = { 0, 0 };
+	file.read(reinterpret_cast<char *>(magic), 2);
+	return !!file && magic[0] == 0x1F && magic[1] == 0x8B;
+}
+
+GzipFile::GzipFile() : InflatingFile(), gz(nullptr)
+{
+}
+
+GzipFile::~GzipFile()
+{
+	this->Close();
+}
+
+void GzipFile::Open(const std::string &fn)
+{
+	this->Close();
+	this->filename = fn;
+
+	// The trailer holds the uncompressed size modulo 4 GB, which covers any
+	// ROM
+	std::ifstream file(fn.c_str(), std::ifstream::in | std::ifstream::binary);
+	file.seekg(-4, std::ifstream::end);
+	unsigned char trailer[4] = { 0, 0, 0, 0 };
+	file.read(reinterpret_cast<char *>(trailer), 4);
+	if (!file)
+		throw std::runtime_error("Unable to open " + fn + " as a gzip file.");
+	file.close();
+
+	this->gz = gzopen(fn.c_str(), "rb");
+	if (!this->gz)
+		throw std::runtime_error("Unable to open " + fn + " as a gzip file.");
+	gzbuffer(static_cast<gzFile>(this->gz), 128 * 1024);
+	this->size = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | (static_cast<uint32_t>(trailer[3]) << 24);
+}
+
+bool GzipFile::Rewind()
+{
+	return !gzrewind(static_cast<gzFile>(this->gz));
+}
+
+int GzipFile::Inflate(uint8_t *buffer, unsigned count)
+{
+	return gzread(static_cast<gzFile>(this->gz), buffer, count);
+}
+
+void GzipFile::Close()
+{
+	if (this->gz)
+		gzclose(static_cast<gzFile>(this->gz));
+	this->gz = nullptr;
+	this->size = 0;
+	this->ResetWindow();
+}
@@ -0,0 +1,72 @@
+/*
+ * SDAT - Inflating file structures
+ * Last modification on 2026-10-16
+ *
+ * Compressed inputs (members of zip archives and gzip files) are inflated as
+ * they are read instead of being decompressed to disk or memory first.
+ * Inflating can only move forward, so the most recently inflated bytes are
+ * kept in a window.  Short steps backwards are served from that window,
+ * while longer ones start inflating again from the beginning.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+struct InflatingFile
+{
+	InflatingFile();
+	virtual ~InflatingFile();
+
+	uint64_t Size() const { return this->size; }
+
+	// Reads up to count bytes from the given offset, stopping early at the end
+	// of the file, and throws an exception on a read error
+	void Read(uint64_t offset, size_t count, std::vector<uint8_t> &buffer);
+
+protected:
+	std::string filename;
+	uint64_t size;
+
+	// Starts inflating from the beginning again, returning false on an error
+	virtual bool Rewind() = 0;
+	// Inflates up to count bytes, returning how many were inflated or a
+	// negative number on an error
+	virtual int Inflate(uint8_t *buffer, unsigned count) = 0;
+
+	void Restart();
+	void ResetWindow();
+
+private:
+	std::vector<uint8_t> window;
+	uint64_t windowStart;
+
+	void InflateBlock();
+
+	InflatingFile(const InflatingFile &);
+	InflatingFile &operator=(const InflatingFile &);
+};
+
+// Checks for the gzip magic number at the start of the file
+bool IsGzipFile(const std::string &filename);
+
+struct GzipFile : InflatingFile
+{
+	GzipFile();
+	~GzipFile();
+
+	// Throws an exception if the file could not be opened, the size comes
+	// from the gzip trailer
+	void Open(const std::string &filename);
+
+protected:
+	bool Rewind();
+	int Inflate(uint8_t *buffer, unsigned count);
+
+private:
+	void *gz;
+
+	void Close();
+};
@@ -0,0 +1,141 @@
+/*
+ * SDAT - Loudness Meter structure
+ * Last modification on 2026-10-16
+ */
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdlib>
+#include "LoudnessMeter.h"
+
+#undef min
+#undef max
+
+const double LoudnessMeter::REFERENCE_LOUDNESS = -18.0;
+
+static inline double EnergyToLoudness(double energy)
+{
+	return -0.691 + 10 * std::log10(energy);
+}
+
+/*
+ * The K-weighting filter coefficients in BS.1770 are only given for 48 kHz,
+ * so they are derived here for the actual rate from the analog prototypes:
+ * a high shelf of about +4 dB above 1.7 kHz, followed by a high pass at
+ * 38 Hz.
+ */
+LoudnessMeter::LoudnessMeter(uint32_t sampleRate) : rate(sampleRate), subBlockFrames(sampleRate / 10), framesInSubBlock(0), shelf(), highPass(), current(), subBlocks()
+{
+	static const double PI = 3.14159265358979323846;
+
+	double K = std::tan(PI * 1681.974450955533 / this->rate), Q = 0.7071752369554196;
+	double Vh = std::pow(10.0, 3.999843853973347 / 20), Vb = std::pow(Vh, 0.4996667741545416);
+	double a0 = 1 + K / Q + K * K;
+	this->shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+	this->shelf.b1 = 2 * (K * K - Vh) / a0;
+	this->shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+	this->shelf.a1 = 2 * (K * K - 1) / a0;
+	this->shelf.a2 = (1 - K / Q + K * K) / a0;
+
+	K = std::tan(PI * 38.13547087602444 / this->rate);
+	Q = 0.5003270373238773;
+	a0 = 1 + K / Q + K * K;
+	this->highPass.b0 = 1;
+	this->highPass.b1 = -2;
+	this->highPass.b2 = 1;
+	this->highPass.a1 = 2 * (K * K - 1) / a0;
+	this->highPass.a2 = (1 - K / Q + K * K) / a0;
+}
+
+// Add interleaved stereo frames to the measurement
+void LoudnessMeter::Add(const int16_t *frames, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		for (int channel = 0; channel < 2; ++channel)
+		{
+			int32_t sample = frames[i * 2 + channel];
+			double in = sample / 32768.0;
+			double weighted = this->highPass.Process(channel, this->shelf.Process(channel, in));
+			this->current.weightedEnergy += weighted * weighted;
+			this->current.squares += in * in;
+			this->current.peak = std::max(this->current.peak, std::abs(sample));
+		}
+
+		if (++this->framesInSubBlock == this->subBlockFrames)
+		{
+			this->subBlocks.push_back(this->current);
+			this->current = SubBlock();
+			this->framesInSubBlock = 0;
+		}
+	}
+}
+
+size_t LoudnessMeter::SubBlockCount(double seconds) const
+{
+	return std::min(this->subBlocks.size(), static_cast<size_t>(std::max(seconds, 0.0) * 10));
+}
+
+// Sample peak, from 0 to 1
+double LoudnessMeter::Peak(double seconds) const
+{
+	int32_t peak = 0;
+	std::for_each(this->subBlocks.begin(), this->subBlocks.begin() + this->SubBlockCount(seconds), [&](const SubBlock &subBlock)
+	{
+		peak = std::max(peak, subBlock.peak);
+	});
+	return peak / 32768.0;
+}
+
+// RMS of both channels, from 0 to 1
+double LoudnessMeter::RMS(double seconds) const
+{
+	size_t count = this->SubBlockCount(seconds);
+	if (!count)
+		return 0;
+	double squares = 0;
+	std::for_each(this->subBlocks.begin(), this->subBlocks.begin() + count, [&](const SubBlock &subBlock)
+	{
+		squares += subBlock.squares;
+	});
+	return std::sqrt(squares / (2.0 * count * this->subBlockFrames));
+}
+
+// Gated integrated loudness in LUFS, or negative infinity if everything was
+// below the absolute gate
+double LoudnessMeter::IntegratedLoudness(double seconds) const
+{
+	size_t count = this->SubBlockCount(seconds);
+	if (count < 4)
+		return -std::numeric_limits<double>::infinity();
+
+	std::vector<double> blockEnergies;
+	blockEnergies.reserve(count - 3);
+	double blockFrames = 4.0 * this->subBlockFrames, absoluteGate = std::pow(10.0, (-70 + 0.691) / 10);
+	for (size_t i = 0; i + 4 <= count; ++i)
+	{
+		double energy = (this->subBlocks[i].weightedEnergy + this->subBlocks[i + 1].weightedEnergy + this->subBlocks[i + 2].weightedEnergy +
+			this->subBlocks[i + 3].weightedEnergy) / blockFrames;
+		if (energy > absoluteGate)
+			blockEnergies.push_back(energy);
+	}
+	if (blockEnergies.empty())
+		return -std::numeric_limits<double>::infinity();
+
+	double total = 0;
+	std::for_each(blockEnergies.begin(), blockEnergies.end(), [&](double energy) { total += energy; });
+	double relativeGate = total / blockEnergies.size() / 10;
+
+	total = 0;
+	size_t gatedBlocks = 0;
+	std::for_each(blockEnergies.begin(), blockEnergies.end(), [&](double energy)
+	{
+		if (energy > relativeGate)
+		{
+			total += energy;
+			++gatedBlocks;
+		}
+	});
+	return EnergyToLoudness(total / gatedBlocks);
+}
@@ -0,0 +1,64 @@
+/*
+ * SDAT - Loudness Meter structure
+ * Last modification on 2026-10-16
+ *
+ * Measures the peak, RMS and integrated loudness of a stream of stereo
+ * samples, the latter following EBU R128 / ITU-R BS.1770 (K-weighting with
+ * 400 ms blocks overlapping by 75%, gated at -70 LUFS and -10 LU).
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+struct LoudnessMeter
+{
+	// The level the replaygain_track_gain tag brings a track to, in LUFS
+	static const double REFERENCE_LOUDNESS;
+
+	LoudnessMeter(uint32_t rate);
+
+	void Add(const int16_t *frames, uint32_t count);
+
+	// These only consider the samples up to the given number of seconds
+	double Peak(double seconds) const;
+	double RMS(double seconds) const;
+	double IntegratedLoudness(double seconds) const;
+
+private:
+	struct Biquad
+	{
+		double b0, b1, b2, a1, a2;
+		double z1[2], z2[2];
+
+		Biquad() : b0(1), b1(0), b2(0), a1(0), a2(0)
+		{
+			this->z1[0] = this->z1[1] = this->z2[0] = this->z2[1] = 0;
+		}
+		double Process(int channel, double in)
+		{
+			double out = this->b0 * in + this->z1[channel];
+			this->z1[channel] = this->b1 * in - this->a1 * out + this->z2[channel];
+			this->z2[channel] = this->b2 * in - this->a2 * out;
+			return out;
+		}
+	};
+
+	// The totals of each 100 ms sub-block, the 400 ms gating blocks are made
+	// up of 4 consecutive sub-blocks
+	struct SubBlock
+	{
+		double weightedEnergy, squares;
+		int32_t peak;
+
+		SubBlock() : weightedEnergy(0), squares(0), peak(0) { }
+	};
+
+	uint32_t rate, subBlockFrames, framesInSubBlock;
+	Biquad shelf, highPass;
+	SubBlock current;
+	std::vector<SubBlock> subBlocks;
+
+	size_t SubBlockCount(double seconds) const;
+};
@@ -0,0 +1,99 @@
+/*
+ * SDAT - Mapped File structure
+ * Last modification on 2026-10-16
+ */
+
+#include "MappedFile.h"
+#ifdef _WIN32
+# include "windowsh_wrapper.h"
+#else
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : data(nullptr), size(0)
+#ifdef _WIN32
+	, file(INVALID_HANDLE_VALUE), mapping(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	this->Close();
+}
+
+bool MappedFile::Open(const std::string &filename)
+{
+	this->Close();
+#ifdef _WIN32
+	HANDLE fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+	this->file = fileHandle;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart <= 0 || static_cast<uint64_t>(fileSize.QuadPart) > SIZE_MAX)
+	{
+		this->Close();
+		return false;
+	}
+	HANDLE mappingHandle = CreateFileMapping(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mappingHandle)
+	{
+		this->Close();
+		return false;
+	}
+	this->mapping = mappingHandle;
+	this->data = static_cast<const uint8_t *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (!this->data)
+	{
+		this->Close();
+		return false;
+	}
+	this->size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size <= 0 || static_cast<uint64_t>(st.st_size) > SIZE_MAX)
+	{
+		close(fd);
+		return false;
+	}
+	void *address = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps its own reference to the file, so the descriptor is
+	// not needed past this point
+	close(fd);
+	if (address == MAP_FAILED)
+		return false;
+	this->data = static_cast<const uint8_t *>(address);
+	this->size = st.st_size;
+	// Signature scans walk the file from front to back, so ask for aggressive
+	// read-ahead and for the kernel to start paging it in now
+	madvise(address, this->size, MADV_SEQUENTIAL);
+	madvise(address, this->size, MADV_WILLNEED);
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (this->data)
+		UnmapViewOfFile(this->data);
+	if (this->mapping)
+		CloseHandle(this->mapping);
+	if (this->file != INVALID_HANDLE_VALUE)
+		CloseHandle(this->file);
+	this->mapping = nullptr;
+	this->file = INVALID_HANDLE_VALUE;
+#else
+	if (this->data)
+		munmap(const_cast<uint8_t *>(this->data), this->size);
+#endif
+	this->data = nullptr;
+	this->size = 0;
+}
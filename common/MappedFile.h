@@ -0,0 +1,38 @@
+/*
+ * SDAT - Mapped File structure
+ * Last modification on 2026-10-16
+ *
+ * A read-only memory mapping of an entire file, used by PseudoReadFile so
+ * large ROMs are paged in from the page cache as they are read instead of
+ * being copied into memory up front.
+ */
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+struct MappedFile
+{
+	MappedFile();
+	~MappedFile();
+
+	// Returns false if the file could not be mapped, in which case the
+	// caller should fall back to reading the file normally
+	bool Open(const std::string &filename);
+
+	const uint8_t *Data() const { return this->data; }
+	size_t Size() const { return this->size; }
+
+private:
+	const uint8_t *data;
+	size_t size;
+#ifdef _WIN32
+	void *file, *mapping;
+#endif
+
+	void Close();
+
+	MappedFile(const MappedFile &);
+	MappedFile &operator=(const MappedFile &);
+};
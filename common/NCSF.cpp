@@ -7,50 +7,338 @@
 #include <fstream>
 #include <memory>
 #include <iostream>
+#include <iomanip>
+#include <limits>
+#include <set>
 #include <cmath>
+#include <cstring>
 #include <zlib.h>
 #include "NCSF.h"
 #include "TimerPlayer.h"
+#include "LoudnessMeter.h"
+#include "ThreadPool.h"
+#ifndef _WIN32
+# include <time.h>
+#endif
 
-// Create an NCSF file
-void MakeNCSF(const std::string &filename, const std::vector<uint8_t> &reservedSectionData, const std::vector<uint8_t> &programSectionData,
-	const std::vector<std::string> &tags)
+#undef min
+#undef max
+
+// Compressed data is written out in chunks of this size as deflate produces it
+static const size_t NCSF_DEFLATE_CHUNK_SIZE = 256 * 1024;
+
+// Program sections larger than a block are compressed a block at a time on
+// all cores, the same way pigz does it.  Each block is primed with the 32 KB
+// before it as a dictionary, so little is lost to the split, and the blocks
+// are always the same size, so the output doesn't depend on the thread count.
+static const size_t NCSF_DEFLATE_BLOCK_SIZE = 128 * 1024;
+static const size_t NCSF_DEFLATE_DICTIONARY_SIZE = 32 * 1024;
+
+struct DeflateSettings
 {
-	// Create zlib compressed version of program section, if one was given
-	auto finalProgramSectionData = programSectionData;
+	int level, windowBits, memLevel, strategy;
+};
 
-	unsigned long programCompressedSize = finalProgramSectionData.empty() ? 0 : compressBound(finalProgramSectionData.size());
-	auto programCompressedData = std::vector<uint8_t>(programCompressedSize);
+// The settings that the max profile tries, all at once, keeping the one that
+// gives the smallest output (or the first of those that tie).  On noisy sample
+// data the lazy matching of the higher levels can lose to the greedy matching
+// of levels 1 to 3, and a larger memLevel, a smaller window or Z_FILTERED each
+// come out ahead at times.
+static const DeflateSettings NCSF_MAX_SETTINGS[] =
+{
+	{ 9, MAX_WBITS, 8, Z_DEFAULT_STRATEGY },
+	{ 9, MAX_WBITS, 9, Z_DEFAULT_STRATEGY },
+	{ 9, MAX_WBITS, 8, Z_FILTERED },
+	{ 9, MAX_WBITS, 9, Z_FILTERED },
+	{ 9, 13, 9, Z_DEFAULT_STRATEGY },
+	{ 3, MAX_WBITS, 8, Z_DEFAULT_STRATEGY },
+	{ 3, MAX_WBITS, 9, Z_DEFAULT_STRATEGY },
+	{ 1, MAX_WBITS, 9, Z_DEFAULT_STRATEGY }
+};
 
-	if (programCompressedSize)
+// Program sections are compressed on one pool shared by every thread making an
+// NCSF, created on first use, instead of each of them starting threads of its
+// own (NCSFWriter makes several NCSFs at once on its own workers).  As Wait
+// waits for every job in the pool, the mutex must be held for as long as one
+// of them is using it.
+static Mutex deflatePoolMutex;
+static std::unique_ptr<ThreadPool> deflatePool;
+
+static ThreadPool &DeflatePool()
+{
+	if (!deflatePool)
+		deflatePool.reset(new ThreadPool());
+	return *deflatePool;
+}
+
+static DeflateSettings GetDeflateSettings(int level)
+{
+	DeflateSettings settings = { level, MAX_WBITS, 8, Z_DEFAULT_STRATEGY };
+	return settings;
+}
+
+struct DeflatedBlock
+{
+	std::vector<uint8_t> data;
+	uLong adler;
+
+	DeflatedBlock() : data(), adler(0)
 	{
-		compress2(&programCompressedData[0], &programCompressedSize, &finalProgramSectionData[0], finalProgramSectionData.size(), 9);
-		programCompressedData.resize(programCompressedSize);
 	}
+};
 
-	// Create file
-	std::ofstream file;
-	file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-	file.open(filename.c_str(), std::ofstream::out | std::ofstream::binary);
+// Copies part of the program section, which may span several segments
+static void CopyFromSegments(const std::vector<GatherList::Segment> &segments, const std::vector<uint64_t> &segmentStarts, uint64_t offset, size_t count,
+	uint8_t *destination)
+{
+	size_t i = std::upper_bound(segmentStarts.begin(), segmentStarts.end(), offset) - segmentStarts.begin() - 1;
+	while (count)
+	{
+		size_t segmentOffset = static_cast<size_t>(offset - segmentStarts[i]);
+		size_t chunk = std::min(count, segments[i].size - segmentOffset);
+		memcpy(destination, segments[i].data + segmentOffset, chunk);
+		destination += chunk;
+		offset += chunk;
+		count -= chunk;
+		++i;
+	}
+}
 
-	PseudoWrite ofile(&file);
+// Compresses a single block as raw deflate data, ending it with a sync flush
+// so the next block starts on a byte boundary, or finishing the stream if
+// this is the last block
+static void DeflateBlock(int level, const uint8_t *dictionary, size_t dictionarySize, const uint8_t *data, size_t size, bool last, DeflatedBlock &block)
+{
+	block.adler = adler32(adler32(0, Z_NULL, 0), data, size);
 
-	ofile.WriteLE("PSF", 3);
-	ofile.WriteLE<uint8_t>(0x25);
-	ofile.WriteLE<uint32_t>(reservedSectionData.empty() ? 0 : reservedSectionData.size());
-	ofile.WriteLE<uint32_t>(programCompressedSize);
-	if (programCompressedSize)
+	z_stream stream = z_stream();
+	if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		throw std::runtime_error("Unable to initialize zlib.");
+	try
+	{
+		if (dictionarySize && deflateSetDictionary(&stream, dictionary, dictionarySize) != Z_OK)
+			throw std::runtime_error("Unable to compress the program section.");
+		stream.next_in = const_cast<Bytef *>(data);
+		stream.avail_in = size;
+		block.data.resize(deflateBound(&stream, size) + 16);
+		size_t produced = 0;
+		int result;
+		do
+		{
+			if (produced == block.data.size())
+				block.data.resize(block.data.size() * 2);
+			stream.next_out = &block.data[produced];
+			stream.avail_out = block.data.size() - produced;
+			result = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+			if (result == Z_STREAM_ERROR)
+				throw std::runtime_error("Unable to compress the program section.");
+			produced = block.data.size() - stream.avail_out;
+		} while (last ? result != Z_STREAM_END : stream.avail_in || !stream.avail_out);
+		block.data.resize(produced);
+	}
+	catch (const std::exception &)
+	{
+		deflateEnd(&stream);
+		throw;
+	}
+	deflateEnd(&stream);
+}
+
+// Compresses the program section block by block on the shared pool, giving out
+// a single zlib stream made from the blocks in order, with the Adler-32 of the
+// whole combined from those of the blocks
+template<typename Emit> static void DeflateInBlocks(const std::vector<GatherList::Segment> &segments, uint64_t totalSize, int level, Emit emit)
+{
+	std::vector<uint64_t> segmentStarts(segments.size());
+	for (size_t i = 1, count = segments.size(); i < count; ++i)
+		segmentStarts[i] = segmentStarts[i - 1] + segments[i - 1].size;
+
+	// Header for deflate with a 32 KB window, with the level bits that deflate
+	// itself would have given it
+	int levelFlags = level == 1 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+	unsigned headerValue = 0x7800 | (levelFlags << 6);
+	headerValue += 31 - headerValue % 31;
+	uint8_t header[] = { static_cast<uint8_t>(headerValue >> 8), static_cast<uint8_t>(headerValue) };
+	emit(header, sizeof(header));
+
+	std::vector<uint64_t> blockStarts;
+	for (uint64_t start = 0; start < totalSize; start += NCSF_DEFLATE_BLOCK_SIZE)
+		blockStarts.push_back(start);
+	uLong adler = adler32(0, Z_NULL, 0);
+	MutexLocker lock(deflatePoolMutex);
+	LoadInOrder<DeflatedBlock>(DeflatePool(), blockStarts, [&](uint64_t start, DeflatedBlock &block)
+	{
+		size_t size = static_cast<size_t>(std::min<uint64_t>(NCSF_DEFLATE_BLOCK_SIZE, totalSize - start));
+		size_t dictionarySize = static_cast<size_t>(std::min<uint64_t>(NCSF_DEFLATE_DICTIONARY_SIZE, start));
+		std::vector<uint8_t> input(dictionarySize + size);
+		CopyFromSegments(segments, segmentStarts, start - dictionarySize, input.size(), &input[0]);
+		DeflateBlock(level, &input[0], dictionarySize, &input[dictionarySize], size, start + size == totalSize, block);
+	}, [&](uint64_t start, DeflatedBlock &block, const std::exception_ptr &error)
+	{
+		if (error)
+			std::rethrow_exception(error);
+		emit(&block.data[0], block.data.size());
+		adler = adler32_combine(adler, block.adler, static_cast<z_off_t>(std::min<uint64_t>(NCSF_DEFLATE_BLOCK_SIZE, totalSize - start)));
+	});
+
+	uint8_t trailer[] = { static_cast<uint8_t>(adler >> 24), static_cast<uint8_t>(adler >> 16), static_cast<uint8_t>(adler >> 8), static_cast<uint8_t>(adler) };
+	emit(trailer, sizeof(trailer));
+}
+
+// Compresses the program section as a single zlib stream, a segment at a
+// time, giving out the compressed data in chunks as it is produced
+template<typename Emit> static void DeflateAsStream(const std::vector<GatherList::Segment> &segments, const DeflateSettings &settings, Emit emit)
+{
+	z_stream stream = z_stream();
+	if (deflateInit2(&stream, settings.level, Z_DEFLATED, settings.windowBits, settings.memLevel, settings.strategy) != Z_OK)
+		throw std::runtime_error("Unable to initialize zlib.");
+	try
+	{
+		std::vector<uint8_t> chunk(NCSF_DEFLATE_CHUNK_SIZE);
+		for (size_t i = 0, count = segments.size(); i < count; ++i)
+		{
+			bool last = i == count - 1;
+			stream.next_in = const_cast<Bytef *>(segments[i].data);
+			stream.avail_in = segments[i].size;
+			int result;
+			do
+			{
+				stream.next_out = &chunk[0];
+				stream.avail_out = chunk.size();
+				result = deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH);
+				if (result == Z_STREAM_ERROR)
+					throw std::runtime_error("Unable to compress the program section.");
+				size_t compressed = chunk.size() - stream.avail_out;
+				if (compressed)
+					emit(&chunk[0], compressed);
+			} while (!stream.avail_out);
+			if (stream.avail_in || (last && result != Z_STREAM_END))
+				throw std::runtime_error("Unable to compress the program section.");
+		}
+	}
+	catch (const std::exception &)
 	{
-		uint32_t crc = crc32(0, Z_NULL, 0);
-		crc = crc32(crc, &programCompressedData[0], programCompressedSize);
-		ofile.WriteLE(crc);
+		deflateEnd(&stream);
+		throw;
 	}
+	deflateEnd(&stream);
+}
+
+// Compresses the program section with each of the max profile's settings on
+// the shared pool, and in blocks the way the default profile does, keeping
+// the smallest output.  The blocks win ties, so max is never larger than
+// default, and otherwise the first of the settings that tie wins.
+static void DeflateSmallest(const std::vector<GatherList::Segment> &segments, uint64_t totalSize, std::vector<uint8_t> &smallest)
+{
+	smallest.clear();
+	if (totalSize > NCSF_DEFLATE_BLOCK_SIZE)
+		DeflateInBlocks(segments, totalSize, 9, [&](const uint8_t *data, size_t size) { smallest.insert(smallest.end(), data, data + size); });
+
+	size_t count = sizeof(NCSF_MAX_SETTINGS) / sizeof(NCSF_MAX_SETTINGS[0]);
+	std::vector<std::vector<uint8_t>> outputs(count);
+	{
+		MutexLocker lock(deflatePoolMutex);
+		ThreadPool &pool = DeflatePool();
+		for (size_t i = 0; i < count; ++i)
+		{
+			std::vector<uint8_t> *output = &outputs[i];
+			const DeflateSettings *settings = &NCSF_MAX_SETTINGS[i];
+			pool.Enqueue([=, &segments]()
+			{
+				DeflateAsStream(segments, *settings, [=](const uint8_t *data, size_t size) { output->insert(output->end(), data, data + size); });
+			});
+		}
+		pool.Wait();
+	}
+
+	std::for_each(outputs.begin(), outputs.end(), [&](std::vector<uint8_t> &output)
+	{
+		if (smallest.empty() || output.size() < smallest.size())
+			smallest.swap(output);
+	});
+}
+
+// Compresses the program section straight into the output a block at a time,
+// giving back the compressed size and its CRC, so that the program section is
+// never held in memory as a whole
+template<typename Write> static void WriteCompressedProgramSection(Write write, const GatherList &programSection, Compression compression,
+	uint32_t &compressedSize, uint32_t &crc)
+{
+	compressedSize = crc = 0;
+	auto segments = programSection.Segments();
+	if (segments.empty())
+		return;
+
+	uint64_t written = 0;
+	crc = crc32(0, Z_NULL, 0);
+	auto emit = [&](const uint8_t *data, size_t size)
+	{
+		crc = crc32(crc, data, size);
+		write(data, size);
+		written += size;
+	};
+
+	uint64_t totalSize = programSection.Size();
+	int level = compression == COMPRESSION_FAST ? 1 : 9;
+	if (compression == COMPRESSION_MAX)
+	{
+		// The trials are kept in memory, so the smallest one is written out
+		// as it is instead of being compressed all over again
+		std::vector<uint8_t> smallest;
+		DeflateSmallest(segments, totalSize, smallest);
+		emit(&smallest[0], smallest.size());
+	}
+	else if (totalSize > NCSF_DEFLATE_BLOCK_SIZE)
+		DeflateInBlocks(segments, totalSize, level, emit);
 	else
-		ofile.WriteLE<uint32_t>(0);
+		DeflateAsStream(segments, GetDeflateSettings(level), emit);
+
+	if (written > std::numeric_limits<uint32_t>::max())
+		throw std::range_error("The compressed program section is too large.");
+	compressedSize = static_cast<uint32_t>(written);
+}
+
+// The current time in seconds, from a monotonic clock, for the stats
+static double GetMonotonicSeconds()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return static_cast<double>(counter.QuadPart) / frequency.QuadPart;
+#else
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+#endif
+}
+
+// Create an NCSF file
+void MakeNCSF(const std::string &filename, const std::vector<uint8_t> &reservedSectionData, const std::vector<uint8_t> &programSectionData,
+	const std::vector<std::string> &tags)
+{
+	GatherList programSection;
+	programSection.Reference(programSectionData);
+	MakeNCSF(filename, reservedSectionData, programSection, tags);
+}
+
+// Writes everything but the program section's compressed size and CRC, which
+// are only known once it has been written, so they are left as 0 for the
+// caller to fill in afterwards
+template<typename Write> static void WriteNCSF(PseudoWrite &ofile, Write writeProgramSection, const std::vector<uint8_t> &reservedSectionData,
+	const GatherList &programSection, const std::vector<std::string> &tags, Compression compression, uint32_t &programCompressedSize, uint32_t &crc)
+{
+	ofile.WriteLE("PSF", 3);
+	ofile.WriteLE<uint8_t>(0x25);
+	ofile.WriteLE<uint32_t>(reservedSectionData.empty() ? 0 : reservedSectionData.size());
+	ofile.WriteLE<uint32_t>(0);
+	ofile.WriteLE<uint32_t>(0);
 	if (!reservedSectionData.empty())
 		ofile.WriteLE(reservedSectionData);
-	if (!programCompressedData.empty())
-		ofile.WriteLE(programCompressedData);
+	ofile.Flush();
+
+	WriteCompressedProgramSection(writeProgramSection, programSection, compression, programCompressedSize, crc);
+
 	if (!tags.empty())
 	{
 		ofile.WriteLE("[TAG]", 5);
@@ -60,16 +348,190 @@ void MakeNCSF(const std::string &filename, const std::vector<uint8_t> &reservedS
 			ofile.WriteLE<uint8_t>(0x0A);
 		}
 	}
+	ofile.Flush();
+}
 
-	file.close();
+static void SetNCSFStats(NCSFStats *stats, const GatherList &programSection, uint32_t programCompressedSize, double startTime)
+{
+	if (stats)
+	{
+		stats->programSize = programSection.Size();
+		stats->compressedSize = programCompressedSize;
+		stats->seconds = GetMonotonicSeconds() - startTime;
+	}
 }
 
-// Check if the given file data is a valid PSF, throwing an exception if it's
-// not a valid PSF
-void CheckForValidPSF(PseudoReadFile &file, uint8_t versionByte)
+void MakeNCSF(const std::string &filename, const std::vector<uint8_t> &reservedSectionData, const GatherList &programSection,
+	const std::vector<std::string> &tags, Compression compression, NCSFStats *stats)
+{
+	double startTime = GetMonotonicSeconds();
+
+	// Create file, under a temporary name that only replaces the real one
+	// once it is complete, so that a failure never leaves a truncated NCSF
+	std::string tempFilename = filename + ".tmp";
+	std::ofstream file;
+	file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+	file.open(tempFilename.c_str(), std::ofstream::out | std::ofstream::binary);
+
+	uint32_t programCompressedSize, crc;
+	try
+	{
+		PseudoWrite ofile(&file);
+		WriteNCSF(ofile, [&](const uint8_t *data, size_t size) { file.write(reinterpret_cast<const char *>(data), size); }, reservedSectionData, programSection,
+			tags, compression, programCompressedSize, crc);
+
+		if (programCompressedSize)
+		{
+			uint8_t sizeAndCRC[8];
+			StoreLE(&sizeAndCRC[0], programCompressedSize);
+			StoreLE(&sizeAndCRC[4], crc);
+			file.seekp(8);
+			file.write(reinterpret_cast<const char *>(sizeAndCRC), sizeof(sizeAndCRC));
+		}
+
+		file.close();
+	}
+	catch (const std::exception &)
+	{
+		file.exceptions(std::ofstream::goodbit);
+		file.close();
+		remove(tempFilename.c_str());
+		throw;
+	}
+	ReplaceFileWith(filename, tempFilename);
+
+	SetNCSFStats(stats, programSection, programCompressedSize, startTime);
+}
+
+void MakeNCSF(std::vector<uint8_t> &ncsfData, const std::vector<uint8_t> &reservedSectionData, const GatherList &programSection,
+	const std::vector<std::string> &tags, Compression compression, NCSFStats *stats)
+{
+	double startTime = GetMonotonicSeconds();
+
+	PseudoWrite ofile;
+	auto &data = ofile.vector->data;
+	uint32_t programCompressedSize, crc;
+	WriteNCSF(ofile, [&](const uint8_t *programData, size_t size) { data.insert(data.end(), programData, programData + size); }, reservedSectionData,
+		programSection, tags, compression, programCompressedSize, crc);
+
+	if (programCompressedSize)
+	{
+		StoreLE(&data[8], programCompressedSize);
+		StoreLE(&data[12], crc);
+	}
+	ncsfData.swap(data);
+
+	SetNCSFStats(stats, programSection, programCompressedSize, startTime);
+}
+
+// Inflates the given zlib stream a chunk at a time, comparing it against the
+// program section as it goes
+static bool CompressedProgramSectionMatches(const uint8_t *compressed, size_t compressedSize, const GatherList &programSection)
+{
+	auto segments = programSection.Segments();
+	z_stream stream = z_stream();
+	if (inflateInit(&stream) != Z_OK)
+		return false;
+	stream.next_in = const_cast<Bytef *>(compressed);
+	stream.avail_in = compressedSize;
+
+	std::vector<uint8_t> chunk(NCSF_DEFLATE_CHUNK_SIZE);
+	size_t segment = 0, segmentOffset = 0;
+	bool matches = true;
+	int result;
+	do
+	{
+		stream.next_out = &chunk[0];
+		stream.avail_out = chunk.size();
+		result = inflate(&stream, Z_NO_FLUSH);
+		if (result != Z_OK && result != Z_STREAM_END)
+		{
+			matches = false;
+			break;
+		}
+		size_t inflated = chunk.size() - stream.avail_out;
+		for (size_t done = 0; matches && done < inflated; )
+		{
+			if (segment == segments.size())
+			{
+				matches = false;
+				break;
+			}
+			size_t count = std::min(inflated - done, segments[segment].size - segmentOffset);
+			if (memcmp(&chunk[done], segments[segment].data + segmentOffset, count))
+				matches = false;
+			done += count;
+			segmentOffset += count;
+			if (segmentOffset == segments[segment].size)
+			{
+				++segment;
+				segmentOffset = 0;
+			}
+		}
+	} while (matches && result != Z_STREAM_END);
+	inflateEnd(&stream);
+	return matches && segment == segments.size();
+}
+
+bool NCSFMatches(const std::string &filename, const std::vector<uint8_t> &reservedSectionData, const GatherList &programSection,
+	const std::vector<std::string> &tags)
+{
+	if (!FileExists(filename))
+		return false;
+	try
+	{
+		PseudoReadFile file(filename);
+		file.GetDataFromFile(filename);
+		CheckForValidPSF(file, 0x25);
+		const uint8_t *data = file.Data();
+		uint32_t reservedSize = ReadLE<uint32_t>(data + 4), programCompressedSize = ReadLE<uint32_t>(data + 8);
+
+		if (reservedSize != reservedSectionData.size() || (reservedSize && memcmp(data + 16, &reservedSectionData[0], reservedSize)))
+			return false;
+
+		// The tags are compared as the bytes MakeNCSF would write for them
+		std::string tagData;
+		if (!tags.empty())
+		{
+			tagData = "[TAG]";
+			std::for_each(tags.begin(), tags.end(), [&](const std::string &tag) { tagData += tag + '\n'; });
+		}
+		size_t tagsOffset = 16 + reservedSize + programCompressedSize;
+		if (file.Size() - tagsOffset != tagData.size() || (!tagData.empty() && memcmp(data + tagsOffset, tagData.data(), tagData.size())))
+			return false;
+
+		if (!programCompressedSize)
+			return !programSection.Size();
+		return CompressedProgramSectionMatches(data + 16 + reservedSize, programCompressedSize, programSection);
+	}
+	catch (const std::exception &)
+	{
+		return false;
+	}
+}
+
+bool GetCompressionFromName(const std::string &name, Compression &compression)
+{
+	std::string lowerName = name;
+	std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), ::tolower);
+	if (lowerName == "fast")
+		compression = COMPRESSION_FAST;
+	else if (lowerName == "default")
+		compression = COMPRESSION_DEFAULT;
+	else if (lowerName == "max")
+		compression = COMPRESSION_MAX;
+	else
+		return false;
+	return true;
+}
+
+// Check if the given PSF header is valid, throwing an exception if it's not.
+// The sizes are checked against the given size of the whole file, as the
+// header may have been read on its own.
+static void CheckPSFHeader(PseudoReadFile &file, uint64_t fileSize, uint8_t versionByte)
 {
 	// Various checks on the file's size will be done throughout
-	if (file.data.size() < 4)
+	if (fileSize < 4)
 		throw std::range_error("File is too small.");
 
 	file.pos = 0;
@@ -86,7 +548,7 @@ void CheckForValidPSF(PseudoReadFile &file, uint8_t versionByte)
 		throw std::runtime_error("Version byte of " + NumToHexString<uint8_t>(PSFHeader[3]) +
 			" does not equal what we were looking for (" + NumToHexString(versionByte) + ").");
 
-	if (file.data.size() < 16)
+	if (fileSize < 16)
 		throw std::range_error("File is too small.");
 
 	// Get the sizes on the reserved and program sections
@@ -96,19 +558,28 @@ void CheckForValidPSF(PseudoReadFile &file, uint8_t versionByte)
 	file.pos += 4;
 
 	// Check the reserved section
-	if (reservedSize && file.data.size() < reservedSize + 16)
+	if (reservedSize && fileSize < reservedSize + 16ull)
 		throw std::range_error("File is too small.");
 
 	file.pos += reservedSize;
 
 	// Check the program section
-	if (programCompressedSize && file.data.size() < reservedSize + programCompressedSize + 16)
+	if (programCompressedSize && fileSize < reservedSize + 16ull + programCompressedSize)
 		throw std::range_error("File is too small.");
 }
 
-// Extract the program section from a PSF.  Does not do any checks on the file,
-// as those will be done in CheckForValidPSF anyways.
-std::vector<uint8_t> GetProgramSectionFromPSF(PseudoReadFile &file, uint8_t versionByte, uint32_t programHeaderSize, uint32_t programSizeOffset, bool addHeaderSize)
+// Check if the given file data is a valid PSF, throwing an exception if it's
+// not a valid PSF
+void CheckForValidPSF(PseudoReadFile &file, uint8_t versionByte)
+{
+	CheckPSFHeader(file, file.Size(), versionByte);
+}
+
+// Inflated data is added in steps of this size while searching for an SDAT
+static const size_t PSF_INFLATE_STEP_SIZE = 1 << 20;
+
+PSFProgramSection::PSFProgramSection(PseudoReadFile &file, uint8_t versionByte, uint32_t programHeaderSize, uint32_t programSizeOffset, bool addHeaderSize) :
+	data(), size(0), stream()
 {
 	// Check to make sure the file is valid
 	CheckForValidPSF(file, versionByte);
@@ -117,34 +588,102 @@ std::vector<uint8_t> GetProgramSectionFromPSF(PseudoReadFile &file, uint8_t vers
 	file.pos = 4;
 	uint32_t reservedSize = file.ReadLE<uint32_t>(), programCompressedSize = file.ReadLE<uint32_t>();
 
-	// Skip the CRC
-	file.pos += 4;
-
 	// We need a program section to continue
 	if (!programCompressedSize)
-		return std::vector<uint8_t>();
-
-	// If there is a reserved section, skip over it
-	if (reservedSize)
-		file.pos += reservedSize;
-
-	// Read the compressed program section
-	auto programSectionCompressed = std::vector<uint8_t>(programCompressedSize);
-	file.ReadLE(programSectionCompressed);
-
-	// Uncompress the program section, the reason uncompress is called twice:
-	// first call is to get just the first 4 bytes that tell the size of the
-	// entire uncompressed section, second call gets everything
-	auto programSectionUncompressed = std::vector<uint8_t>(programHeaderSize);
-	unsigned long programUncompressedSize = programHeaderSize;
-	uncompress(&programSectionUncompressed[0], &programUncompressedSize, &programSectionCompressed[0], programCompressedSize);
-	programUncompressedSize = ReadLE<uint32_t>(&programSectionUncompressed[programSizeOffset]);
+		return;
+
+	// The compressed program section comes after the header and the reserved
+	// section, CheckForValidPSF made sure that all of it is there
+	this->stream.reset(new z_stream());
+	this->stream->next_in = const_cast<Bytef *>(file.Data() + file.startOffset + 16 + reservedSize);
+	this->stream->avail_in = programCompressedSize;
+	if (inflateInit(this->stream.get()) != Z_OK)
+	{
+		this->stream.reset();
+		throw std::runtime_error("Unable to initialize zlib.");
+	}
+
+	// The header gives the size of the entire uncompressed section
+	this->size = programHeaderSize;
+	this->InflateTo(programHeaderSize);
+	uint32_t programUncompressedSize = ReadLE<uint32_t>(&this->data[programSizeOffset]);
 	if (addHeaderSize)
 		programUncompressedSize += programHeaderSize;
-	programSectionUncompressed.resize(programUncompressedSize);
-	uncompress(&programSectionUncompressed[0], &programUncompressedSize, &programSectionCompressed[0], programCompressedSize);
+	this->size = programUncompressedSize;
+	if (!this->stream || this->data.size() > this->size)
+		this->data.resize(this->size);
+	this->data.reserve(this->size);
+}
+
+PSFProgramSection::~PSFProgramSection()
+{
+	if (this->stream)
+		inflateEnd(this->stream.get());
+}
+
+void PSFProgramSection::InflateTo(size_t wanted)
+{
+	wanted = std::min(wanted, this->size);
+	while (this->data.size() < wanted && this->stream)
+	{
+		size_t filled = this->data.size();
+		this->data.resize(wanted);
+		this->stream->next_out = &this->data[filled];
+		this->stream->avail_out = static_cast<uInt>(wanted - filled);
+		int result = inflate(this->stream.get(), Z_NO_FLUSH);
+		this->data.resize(wanted - this->stream->avail_out);
+		// Running out of compressed data early leaves the rest zeroed, as
+		// uncompress did before
+		if (result == Z_STREAM_END || result == Z_BUF_ERROR)
+			this->Finish();
+		else if (result != Z_OK)
+		{
+			this->Finish();
+			throw std::runtime_error("Unable to inflate the program section.");
+		}
+	}
+}
 
-	return std::vector<uint8_t>(programSectionUncompressed.begin(), programSectionUncompressed.end());
+uint32_t PSFProgramSection::InflatePastSDAT(size_t start)
+{
+	static const uint8_t sdatSignature[] = { 0x53, 0x44, 0x41, 0x54, 0xFF, 0xFE, 0x00, 0x01 };
+
+	// Each step is searched from just before where the last one ended, in
+	// case the signature straddles them
+	int64_t sdatOffset = -1;
+	size_t searched = start;
+	this->InflateTo(start + PSF_INFLATE_STEP_SIZE);
+	while ((sdatOffset = FindSignature(this->data.empty() ? nullptr : &this->data[0], this->data.size(), searched, sdatSignature, sizeof(sdatSignature))) == -1)
+	{
+		size_t filled = this->data.size();
+		if (filled >= this->size)
+			throw std::runtime_error("Unable to find an SDAT in the program section.");
+		searched = std::max(start, filled - std::min(filled, sizeof(sdatSignature) - 1));
+		this->InflateTo(filled + PSF_INFLATE_STEP_SIZE);
+	}
+
+	// The SDAT's size is 8 bytes into its header
+	size_t offset = static_cast<size_t>(sdatOffset);
+	this->InflateTo(offset + 12);
+	if (this->data.size() >= offset + 12)
+		this->InflateTo(offset + ReadLE<uint32_t>(&this->data[offset + 8]));
+	return static_cast<uint32_t>(offset);
+}
+
+void PSFProgramSection::Finish()
+{
+	this->data.resize(this->size);
+	inflateEnd(this->stream.get());
+	this->stream.reset();
+}
+
+// Extract the program section from a PSF.  Does not do any checks on the file,
+// as those will be done in CheckForValidPSF anyways.
+std::vector<uint8_t> GetProgramSectionFromPSF(PseudoReadFile &file, uint8_t versionByte, uint32_t programHeaderSize, uint32_t programSizeOffset, bool addHeaderSize)
+{
+	PSFProgramSection programSection(file, versionByte, programHeaderSize, programSizeOffset, addHeaderSize);
+	programSection.InflateTo(programSection.Size());
+	return std::move(programSection.data);
 }
 
 // The whitespace trimming was modified from the following answer on Stack Overflow:
@@ -175,59 +714,72 @@ static inline std::string TrimWhitespace(const std::string &orig)
 	return LeftTrimWhitespace(RightTrimWhitespace(orig));
 }
 
-// Get only the tags from the PSF
-TagList GetTagsFromPSF(PseudoReadFile &file, uint8_t versionByte)
+// Parses the tags from the data that follows the program section.  Each line
+// is split at its first '=', with any further '=' being left out of the value,
+// and a last line without a newline is ignored.
+static TagList ParseTags(const uint8_t *data, size_t size)
 {
-	// Check to make sure the file is valid
-	CheckForValidPSF(file, versionByte);
-
 	TagList tags;
 
-	// Get the starting offset of the tags
-	char TagHeader[] = "[TAG]";
-	auto TagHeaderVector = std::vector<uint8_t>(TagHeader, TagHeader + 5);
-	int32_t TagOffset = file.GetNextOffset(0, TagHeaderVector);
+	static const uint8_t TagHeader[] = { '[', 'T', 'A', 'G', ']' };
+	int64_t TagOffset = FindSignature(data, size, 0, TagHeader, sizeof(TagHeader));
 
 	// Only continue on if we have tags
-	if (TagOffset != -1)
+	if (TagOffset == -1)
+		return tags;
+
+	const char *line = reinterpret_cast<const char *>(data) + TagOffset + sizeof(TagHeader), *end = reinterpret_cast<const char *>(data) + size;
+	const char *newline;
+	for (; (newline = static_cast<const char *>(memchr(line, 0x0A, end - line))); line = newline + 1)
 	{
-		file.pos = TagOffset + 5;
-		std::string name, value;
-		bool onName = true;
-		size_t lengthOfTags = file.data.size() - file.pos;
-		for (size_t x = 0; x < lengthOfTags; ++x)
-		{
-			char curr = file.ReadLE<uint8_t>();
-			if (curr == 0x0A)
-			{
-				if (!name.empty() && !value.empty())
-				{
-					name = TrimWhitespace(name);
-					value = TrimWhitespace(value);
-					if (tags.Exists(name))
-						tags[name] += "\n" + value;
-					else
-						tags[name] = value;
-				}
-				name = value = "";
-				onName = true;
-				continue;
-			}
-			if (curr == '=')
-			{
-				onName = false;
-				continue;
-			}
-			if (onName)
-				name += curr;
-			else
-				value += curr;
-		}
+		const char *equals = std::find(line, newline, '=');
+		if (equals == line || std::find_if(equals, newline, [](char c) { return c != '='; }) == newline)
+			continue;
+		std::string name = TrimWhitespace(std::string(line, equals)), value(equals + 1, newline);
+		value.erase(std::remove(value.begin(), value.end(), '='), value.end());
+		value = TrimWhitespace(value);
+		if (tags.Exists(name))
+			tags[name] += "\n" + value;
+		else
+			tags[name] = value;
 	}
 
 	return tags;
 }
 
+// Get only the tags from the PSF
+TagList GetTagsFromPSF(PseudoReadFile &file, uint8_t versionByte)
+{
+	// Check to make sure the file is valid
+	CheckForValidPSF(file, versionByte);
+
+	// Get the starting offset of the tags, which come after the program section
+	file.pos = 4;
+	uint32_t reservedSize = file.ReadLE<uint32_t>(), programCompressedSize = file.ReadLE<uint32_t>();
+	size_t tagsOffset = 16 + reservedSize + programCompressedSize;
+	return ParseTags(file.Data() + tagsOffset, file.Size() - tagsOffset);
+}
+
+// Same as above, but only the header and what follows the program section are
+// read from the file, the reserved and program sections are skipped over
+TagList GetTagsFromPSF(const std::string &filename, uint8_t versionByte)
+{
+	RangedFile file;
+	file.Open(filename);
+	PseudoReadFile header(filename);
+	header.GetDataFromFile(file, 0, 16);
+
+	// Check to make sure the file is valid
+	CheckPSFHeader(header, file.Size(), versionByte);
+
+	header.pos = 4;
+	uint32_t reservedSize = header.ReadLE<uint32_t>(), programCompressedSize = header.ReadLE<uint32_t>();
+	uint64_t tagsOffset = 16ull + reservedSize + programCompressedSize;
+	std::vector<uint8_t> tagData;
+	file.Read(tagsOffset, static_cast<size_t>(file.Size() - tagsOffset), tagData);
+	return ParseTags(tagData.empty() ? nullptr : &tagData[0], tagData.size());
+}
+
 // A simple function to get a file's extension
 static auto GetExtension = [](const std::string &filename) -> std::string
 {
@@ -280,12 +832,26 @@ void RemoveFiles(const Files &files)
 	std::for_each(files.begin(), files.end(), [](const std::string &file) { remove(file.c_str()); });
 }
 
+void RemoveOtherFiles(const Files &files, const Files &filesToKeep)
+{
+	std::set<std::string> keep(filesToKeep.begin(), filesToKeep.end());
+	std::for_each(files.begin(), files.end(), [&](const std::string &file)
+	{
+		if (!keep.count(file))
+			remove(file.c_str());
+	});
+}
+
 // Get time on SSEQ (uses a separate thread so it can be killed off if it takes longer than a few seconds)
+// The loop count is in units of 150 ms, but the thread is checked on more often
+// than that so a player that gives up early is not waited on for long
 static Time GetTime(TimerPlayer *player, uint32_t loopCount, uint32_t numberOfLoops)
 {
+	static const uint32_t CHECKSPERLOOP = 15;
 	player->loops = numberOfLoops;
 	player->StartLengthThread();
 	uint32_t i = 0;
+	loopCount *= CHECKSPERLOOP;
 	for (; i < loopCount; ++i)
 	{
 		player->LockMutex();
@@ -294,11 +860,11 @@ static Time GetTime(TimerPlayer *player, uint32_t loopCount, uint32_t numberOfLo
 		if (doingLength)
 		{
 #ifdef _WIN32
-			Sleep(150);
+			Sleep(150 / CHECKSPERLOOP);
 #else
 			timespec req;
 			req.tv_sec = 0;
-			req.tv_nsec = 150000000;
+			req.tv_nsec = 150000000 / CHECKSPERLOOP;
 			while (nanosleep(&req, &req) == -1 && errno == EINTR);
 #endif
 		}
@@ -349,11 +915,42 @@ static inline int Cnv_Scale(int scale)
 	return lut[scale];
 }
 
+// Set up the player to "play" the notes of the SSEQ, giving it the SSEQ's
+// volume as well as the SBNK and SWARs the SSEQ uses
+void SetupPlayerForNotes(TimerPlayer *player, const SDAT *sdat, const SSEQ *sseq)
+{
+	const auto &info = sdat->infoSection.SEQrecord.entries[sseq->entryNumber];
+	player->sseqVol = Cnv_Scale(info.vol);
+	player->Setup(sseq, info.origFilename);
+	const auto &sbnkInfo = sdat->infoSection.BANKrecord.entries[info.bank];
+	player->sbnk = sbnkInfo.sbnk;
+	for (int i = 0; i < 4; ++i)
+		if (sbnkInfo.waveArc[i] != 0xFFFF)
+			player->swar[i] = sdat->infoSection.WAVEARCrecord.entries[sbnkInfo.waveArc[i]].swar;
+}
+
+// The loudness passes render at the rate R128 is specified at
+static const uint32_t LOUDNESS_RATE = 48000;
+
+// Have the notes pass of the player render every sample into the meter, the
+// given maximum seconds is used to allow the much slower pass more time
+static uint32_t AttachLoudnessMeter(TimerPlayer *player, LoudnessMeter *meter)
+{
+	player->SetupRender(LOUDNESS_RATE, INTERPOLATION_SINC);
+	player->loudness = meter;
+	return 40 + player->maxSeconds * 2;
+}
+
 // Get time on SSEQ, will run the player at least once (without "playing" the
 // music), if the song is one-shot (and not looping), it will run the player
 // a second time, "playing" the song to determine when silence has occurred.
-// After which, it will store the data in the tags for the SSEQ.
-void GetTime(const std::string &filename, const SDAT *sdat, const SSEQ *sseq, TagList &tags, bool verbose, uint32_t numberOfLoops, uint32_t fadeLoop, uint32_t fadeOneShot)
+// After which, it will store the data in the tags for the SSEQ.  If loudness
+// is being measured, it is done during that second run, and looping songs
+// will be "played" up to their length to measure them.  If a loop sample rate
+// is given, the loop points of looping songs are stored as well, both in
+// seconds and in samples at that rate.
+void GetTime(const std::string &filename, const SDAT *sdat, const SSEQ *sseq, TagList &tags, bool verbose, uint32_t numberOfLoops, uint32_t fadeLoop, uint32_t fadeOneShot,
+	bool measureLoudness, uint32_t loopSampleRate)
 {
 	const auto &info = sdat->infoSection.SEQrecord.entries[sseq->entryNumber];
 	auto player = std::unique_ptr<TimerPlayer>(new TimerPlayer());
@@ -361,22 +958,24 @@ void GetTime(const std::string &filename, const SDAT *sdat, const SSEQ *sseq, Ta
 	player->maxSeconds = 6000;
 	// Get the time, without "playing" the notes
 	Time length = GetTime(player.get(), 20, numberOfLoops);
+	Time loop = player->LoopPoints();
 	// If the length was for a one-shot song, get the time again, this time "playing" the notes
 	bool gotLength = false;
+	std::unique_ptr<LoudnessMeter> meter;
 	if (static_cast<int>(length.time) != -1 && length.type == END)
 	{
 		player.reset(new TimerPlayer());
-		player->sseqVol = Cnv_Scale(info.vol);
-		player->Setup(sseq, info.origFilename);
-		const auto &sbnkInfo = sdat->infoSection.BANKrecord.entries[info.bank];
-		player->sbnk = sbnkInfo.sbnk;
-		for (int i = 0; i < 4; ++i)
-			if (sbnkInfo.waveArc[i] != 0xFFFF)
-				player->swar[i] = sdat->infoSection.WAVEARCrecord.entries[sbnkInfo.waveArc[i]].swar;
+		SetupPlayerForNotes(player.get(), sdat, sseq);
 		player->maxSeconds = length.time + 30;
 		player->doNotes = true;
+		uint32_t loopCount = 40;
+		if (measureLoudness)
+		{
+			meter.reset(new LoudnessMeter(LOUDNESS_RATE));
+			loopCount = AttachLoudnessMeter(player.get(), meter.get());
+		}
 		Time oldLength = length;
-		length = GetTime(player.get(), 40, numberOfLoops);
+		length = GetTime(player.get(), loopCount, numberOfLoops);
 		if (static_cast<int>(length.time) != -1)
 			gotLength = true;
 		else
@@ -398,11 +997,68 @@ void GetTime(const std::string &filename, const SDAT *sdat, const SSEQ *sseq, Ta
 			if (length.type == END && !gotLength)
 				std::cout << "(NOTE: Was unable to detect silence at the end of the track, time may be inaccurate.)\n";
 		}
+
+		if (loopSampleRate)
+		{
+			if (length.type == LOOP && loop.time >= 0 && loop.loopStart >= 0)
+			{
+				tags["loop_start"] = SecondsToString(loop.loopStart);
+				tags["loop_end"] = SecondsToString(loop.time);
+				tags["loop_start_samples"] = stringify(static_cast<uint64_t>(loop.loopStart * loopSampleRate + 0.5));
+				tags["loop_end_samples"] = stringify(static_cast<uint64_t>(loop.time * loopSampleRate + 0.5));
+				if (verbose)
+					std::cout << "Loop for " << filename << ": " << tags["loop_start"] << " to " << tags["loop_end"] << "\n";
+			}
+			else
+			{
+				tags.Remove("loop_start");
+				tags.Remove("loop_end");
+				tags.Remove("loop_start_samples");
+				tags.Remove("loop_end_samples");
+			}
+		}
+
+		if (measureLoudness)
+		{
+			if (!meter)
+			{
+				player.reset(new TimerPlayer());
+				SetupPlayerForNotes(player.get(), sdat, sseq);
+				player->maxSeconds = static_cast<uint32_t>(std::ceil(length.time));
+				meter.reset(new LoudnessMeter(LOUDNESS_RATE));
+				GetTime(player.get(), AttachLoudnessMeter(player.get(), meter.get()), numberOfLoops);
+			}
+
+			double loudness = meter->IntegratedLoudness(length.time);
+			if (loudness > -std::numeric_limits<double>::infinity())
+			{
+				double peak = meter->Peak(length.time);
+				std::ostringstream gain, peakString;
+				gain << std::fixed << std::setprecision(2) << std::showpos << LoudnessMeter::REFERENCE_LOUDNESS - loudness << " dB";
+				peakString << std::fixed << std::setprecision(6) << peak;
+				tags["replaygain_track_gain"] = gain.str();
+				tags["replaygain_track_peak"] = peakString.str();
+				if (verbose)
+				{
+					std::ostringstream levels;
+					levels << std::fixed << std::setprecision(2) << loudness << " LUFS, peak " << 20 * std::log10(peak) << " dBFS, RMS " <<
+						20 * std::log10(meter->RMS(length.time)) << " dBFS";
+					std::cout << "Loudness for " << filename << ": " << levels.str() << "\n";
+				}
+			}
+			else
+			{
+				tags.Remove("replaygain_track_gain");
+				tags.Remove("replaygain_track_peak");
+				if (verbose)
+					std::cout << "Unable to measure loudness for " << filename << " (silent)\n";
+			}
+		}
 	}
 	else if (verbose)
 	{
 		tags.Remove("fade");
 		tags.Remove("length");
-		std::cout << "Unable to calculate time for " << filename << "\n";
+		std::cout << "Unable to calculate time for " << filename << (player->abortReason.empty() ? "" : " (" + player->abortReason + ")") << "\n";
 	}
 }
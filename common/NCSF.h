@@ -14,11 +14,87 @@
 
 typedef std::vector<std::string> Files;
 
+struct TimerPlayer;
+struct z_stream_s;
+
+// How hard MakeNCSF tries to compress the program section: fast uses level 1,
+// default uses level 9, and max tries several settings at once and keeps the
+// smallest
+enum Compression
+{
+	COMPRESSION_FAST,
+	COMPRESSION_DEFAULT,
+	COMPRESSION_MAX
+};
+
+// What MakeNCSF reports about the program section it compressed
+struct NCSFStats
+{
+	uint64_t programSize;
+	uint32_t compressedSize;
+	double seconds;
+
+	NCSFStats() : programSize(0), compressedSize(0), seconds(0)
+	{
+	}
+};
+
+// Inflates the program section of a PSF in a single pass, only as far as is
+// asked for.  The first programHeaderSize bytes hold the uncompressed size at
+// programSizeOffset (which doesn't count the header if addHeaderSize is set),
+// so the data is allocated once at its exact size.  The compressed data is
+// read from where it is in the file, which must outlive this.
+struct PSFProgramSection
+{
+	std::vector<uint8_t> data;
+
+	PSFProgramSection(PseudoReadFile &file, uint8_t versionByte, uint32_t programHeaderSize, uint32_t programSizeOffset, bool addHeaderSize = false);
+	~PSFProgramSection();
+
+	// The full uncompressed size, from the header
+	size_t Size() const { return this->size; }
+
+	// Inflates until data holds at least the given number of bytes, or all of
+	// them, and throws an exception if the compressed data is corrupt
+	void InflateTo(size_t wanted);
+	// Inflates until the first SDAT at or after the given offset has been
+	// passed, returning its offset, and throws an exception if there is none
+	uint32_t InflatePastSDAT(size_t start = 0);
+
+private:
+	size_t size;
+	std::unique_ptr<z_stream_s> stream;
+
+	void Finish();
+
+	PSFProgramSection(const PSFProgramSection &);
+	PSFProgramSection &operator=(const PSFProgramSection &);
+};
+
 void MakeNCSF(const std::string &filename, const std::vector<uint8_t> &reservedSectionData, const std::vector<uint8_t> &programSectionData,
 	const std::vector<std::string> &tags = std::vector<std::string>());
+void MakeNCSF(const std::string &filename, const std::vector<uint8_t> &reservedSectionData, const GatherList &programSection,
+	const std::vector<std::string> &tags = std::vector<std::string>(), Compression compression = COMPRESSION_DEFAULT, NCSFStats *stats = nullptr);
+// As above, but the NCSF is made in memory, for storing in an archive
+void MakeNCSF(std::vector<uint8_t> &ncsfData, const std::vector<uint8_t> &reservedSectionData, const GatherList &programSection,
+	const std::vector<std::string> &tags = std::vector<std::string>(), Compression compression = COMPRESSION_DEFAULT, NCSFStats *stats = nullptr);
+// Checks if the NCSF at the given filename already holds exactly what
+// MakeNCSF would write to it, however it was compressed, so that writing it
+// again can be skipped.  The existing program section is inflated a chunk at a
+// time and compared as it goes, and anything unreadable counts as different.
+bool NCSFMatches(const std::string &filename, const std::vector<uint8_t> &reservedSectionData, const GatherList &programSection,
+	const std::vector<std::string> &tags = std::vector<std::string>());
+// Gets the compression profile from its name (fast, default or max), returning
+// false if there is no such profile
+bool GetCompressionFromName(const std::string &name, Compression &compression);
 void CheckForValidPSF(PseudoReadFile &file, uint8_t versionByte);
 std::vector<uint8_t> GetProgramSectionFromPSF(PseudoReadFile &file, uint8_t versionByte, uint32_t programHeaderSize, uint32_t programSizeOffset, bool addHeaderSize = false);
 TagList GetTagsFromPSF(PseudoReadFile &file, uint8_t versionByte);
+TagList GetTagsFromPSF(const std::string &filename, uint8_t versionByte);
 Files GetFilesInDirectory(const std::string &path, const std::vector<std::string> &extensions = std::vector<std::string>());
 void RemoveFiles(const Files &files);
-void GetTime(const std::string &filename, const SDAT *sdat, const SSEQ *sseq, TagList &tags, bool verbose, uint32_t numberOfLoops, uint32_t fadeLoop, uint32_t fadeOneShot);
+// Removes the files that are not also in the list of files to keep
+void RemoveOtherFiles(const Files &files, const Files &filesToKeep);
+void SetupPlayerForNotes(TimerPlayer *player, const SDAT *sdat, const SSEQ *sseq);
+void GetTime(const std::string &filename, const SDAT *sdat, const SSEQ *sseq, TagList &tags, bool verbose, uint32_t numberOfLoops, uint32_t fadeLoop, uint32_t fadeOneShot,
+	bool measureLoudness = false, uint32_t loopSampleRate = 0);
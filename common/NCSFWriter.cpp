@@ -0,0 +1,131 @@
+/*
+ * SDAT - NCSF writer structure
+ * Last modification on 2026-10-16
+ */
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include "NCSFWriter.h"
+
+// Each worker can have this many more files waiting behind it before Add
+// blocks, which only bounds the reserved sections and tags held, as the
+// program sections are referenced
+static const unsigned NCSF_QUEUED_PER_THREAD = 2;
+
+NCSFWriter::NCSFWriter(bool isVerbose, Compression compressionProfile, bool shouldKeepUnchanged, unsigned threadCount) : verbose(isVerbose),
+	compression(compressionProfile), keepUnchanged(shouldKeepUnchanged), filenames(), noProgramSection(), archive(), mutex(), outputs(),
+	pool(threadCount, NCSF_QUEUED_PER_THREAD * (threadCount ? threadCount : ThreadPool::HardwareThreads()))
+{
+}
+
+void NCSFWriter::OpenArchive(const std::string &archiveFilename)
+{
+	this->archive.Open(archiveFilename);
+}
+
+void NCSFWriter::Add(const std::string &filename, const std::vector<uint8_t> &reservedSectionData, const GatherList &programSection,
+	const std::vector<std::string> &tags)
+{
+	this->Report();
+
+	this->filenames.push_back(filename);
+	Output *output;
+	{
+		MutexLocker lock(this->mutex);
+		this->outputs.push_back(Output(filename));
+		output = &this->outputs.back();
+	}
+
+	const GatherList *program = &programSection;
+	Mutex *outputMutex = &this->mutex;
+	Compression fileCompression = this->compression;
+	bool toArchive = this->archive.IsOpen(), checkUnchanged = this->keepUnchanged && !toArchive;
+	this->pool.Enqueue([=]()
+	{
+		std::exception_ptr error;
+		NCSFStats stats;
+		bool kept = false;
+		std::vector<uint8_t> data;
+		try
+		{
+			kept = checkUnchanged && NCSFMatches(filename, reservedSectionData, *program, tags);
+			if (toArchive)
+				MakeNCSF(data, reservedSectionData, *program, tags, fileCompression, &stats);
+			else if (!kept)
+				MakeNCSF(filename, reservedSectionData, *program, tags, fileCompression, &stats);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+		MutexLocker lock(*outputMutex);
+		output->error = error;
+		output->stats = stats;
+		output->kept = kept;
+		output->data.swap(data);
+		output->done = true;
+	});
+}
+
+void NCSFWriter::Add(const std::string &filename, const std::vector<uint8_t> &reservedSectionData, const std::vector<std::string> &tags)
+{
+	this->Add(filename, reservedSectionData, this->noProgramSection, tags);
+}
+
+void NCSFWriter::Finish(const Files &previousFiles)
+{
+	try
+	{
+		this->pool.Wait();
+		this->Report();
+	}
+	catch (const std::exception &)
+	{
+		RemoveOtherFiles(previousFiles, this->filenames);
+		throw;
+	}
+	RemoveOtherFiles(previousFiles, this->filenames);
+	if (this->archive.IsOpen())
+		this->archive.Close();
+}
+
+// Reports the files at the front of the queue that are done, stopping at the
+// first that isn't, and rethrows the error of the first that failed.  Files for
+// the archive are stored here, so that they go in in the order they were added.
+void NCSFWriter::Report()
+{
+	for (;;)
+	{
+		std::string filename;
+		std::exception_ptr error;
+		NCSFStats stats;
+		bool kept;
+		std::vector<uint8_t> data;
+		{
+			MutexLocker lock(this->mutex);
+			if (this->outputs.empty() || !this->outputs.front().done)
+				return;
+			filename = this->outputs.front().filename;
+			error = this->outputs.front().error;
+			stats = this->outputs.front().stats;
+			kept = this->outputs.front().kept;
+			data.swap(this->outputs.front().data);
+			this->outputs.pop_front();
+		}
+		if (error)
+			std::rethrow_exception(error);
+		if (this->archive.IsOpen())
+			this->archive.Store(GetFilenameFromPath(filename), data);
+		if (this->verbose)
+		{
+			std::ostringstream line;
+			line << (kept ? "Kept " : "Created ") << GetFilenameFromPath(filename);
+			if (kept)
+				line << " (unchanged)";
+			else if (stats.programSize)
+				line << " (" << stats.programSize << " bytes compressed to " << stats.compressedSize << " in " << std::fixed << std::setprecision(2) << stats.seconds << "s)";
+			std::cout << line.str() << "\n";
+		}
+	}
+}
@@ -0,0 +1,82 @@
+/*
+ * SDAT - NCSF writer structure
+ * Last modification on 2026-10-16
+ *
+ * Compresses and writes NCSFs on worker threads, so that the calling thread
+ * can carry on timing the next track while the NCSFLIB is being compressed.
+ * Files are reported as created, and errors are rethrown, in the order they
+ * were added, no matter the order the workers finish them in.  The files can
+ * instead be stored in a single zip archive, in the same order.
+ */
+
+#pragma once
+
+#include <deque>
+#include "NCSF.h"
+#include "GatherList.h"
+#include "ThreadPool.h"
+#include "ZipArchive.h"
+
+struct NCSFWriter
+{
+	// If verbose is set, "Created <filename>" is output for each file, along
+	// with how large its program section was, how large it was compressed with
+	// the given profile, and how long that took.  If keepUnchanged is set, a
+	// file that already holds exactly what would be written is left alone
+	// (and "Kept <filename>" is output instead), see NCSFMatches.
+	NCSFWriter(bool verbose, Compression compression = COMPRESSION_DEFAULT, bool keepUnchanged = false, unsigned threadCount = 0);
+
+	// Stores the files in the given zip archive instead of writing them out,
+	// each named by its filename without the directory, must be called before
+	// any files are added.  The archive is finished by Finish.
+	void OpenArchive(const std::string &archiveFilename);
+
+	// Queues the NCSF to be made, blocking while the queue is full.  The
+	// program section is only referenced and must outlive the call to Finish.
+	// Any files that have been finished are reported first, and the error
+	// from the earliest file that failed is rethrown.
+	void Add(const std::string &filename, const std::vector<uint8_t> &reservedSectionData, const GatherList &programSection,
+		const std::vector<std::string> &tags = std::vector<std::string>());
+	// As above, for an NCSF without a program section
+	void Add(const std::string &filename, const std::vector<uint8_t> &reservedSectionData, const std::vector<std::string> &tags = std::vector<std::string>());
+
+	// Waits for all of the queued files, reporting them and rethrowing the
+	// error from the earliest file that failed, then finishes the archive if
+	// there is one.  Any of the given files from a previous run that were not
+	// added are removed, even if a file failed, as the set they belonged to is
+	// being replaced either way.  (If Finish is never reached, they are left.)
+	void Finish(const Files &previousFiles = Files());
+
+private:
+	struct Output
+	{
+		std::string filename;
+		bool done;
+		std::exception_ptr error;
+		NCSFStats stats;
+		bool kept;
+		// The NCSF itself, when it is to be stored in the archive
+		std::vector<uint8_t> data;
+
+		Output(const std::string &outputFilename) : filename(outputFilename), done(false), error(), stats(), kept(false), data()
+		{
+		}
+	};
+
+	bool verbose;
+	Compression compression;
+	bool keepUnchanged;
+	Files filenames;
+	GatherList noProgramSection;
+	ZipArchiveWriter archive;
+	Mutex mutex;
+	std::deque<Output> outputs;
+	// Declared last so that its workers are finished with before the rest is
+	// destroyed
+	ThreadPool pool;
+
+	void Report();
+
+	NCSFWriter(const NCSFWriter &);
+	NCSFWriter &operator=(const NCSFWriter &);
+};
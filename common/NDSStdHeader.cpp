@@ -16,11 +16,12 @@ NDSStdHeader::NDSStdHeader() : magic(0), fileSize(0), size(0), blocks(0)
 
 void NDSStdHeader::Read(PseudoReadFile &file)
 {
-	file.ReadLE(this->type);
-	this->magic = file.ReadLE<uint32_t>();
-	this->fileSize = file.ReadLE<uint32_t>();
-	this->size = file.ReadLE<uint16_t>();
-	this->blocks = file.ReadLE<uint16_t>(); // # of blocks
+	auto header = file.CheckRegion(16);
+	header.ReadLE(this->type);
+	this->magic = header.ReadLE<uint32_t>();
+	this->fileSize = header.ReadLE<uint32_t>();
+	this->size = header.ReadLE<uint16_t>();
+	this->blocks = header.ReadLE<uint16_t>(); // # of blocks
 }
 
 void NDSStdHeader::Verify(const std::string &typeToCheck, uint32_t magicToCheck) const
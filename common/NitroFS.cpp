@@ -0,0 +1,122 @@
+/*
+ * SDAT - NitroFS (NDS ROM filesystem) structures
+ * Last modification on 2026-10-16
+ */
+
+#include "NitroFS.h"
+
+NitroFSFile::NitroFSFile(uint32_t fileOffset, uint32_t fileSize) : path(""), offset(fileOffset), size(fileSize)
+{
+}
+
+NitroFS::NitroFS() : files()
+{
+}
+
+// Reads the filesystem from a ROM that is entirely in memory, throwing an
+// exception if the ROM header does not point to a usable filesystem
+void NitroFS::Read(PseudoReadFile &file)
+{
+	uint32_t fntOffset, fntSize, fatOffset, fatSize;
+	NitroFS::ReadHeader(file, file.Size(), fntOffset, fntSize, fatOffset, fatSize);
+
+	PseudoReadFile fnt, fat;
+	fnt.ViewData(file.Data() + fntOffset, fntSize);
+	fat.ViewData(file.Data() + fatOffset, fatSize);
+	this->ReadTables(fnt, fat, file.Size());
+}
+
+// Reads the filesystem using the already loaded ROM header, with only the FNT
+// and FAT being read from the file itself
+void NitroFS::Read(RangedFile &file, PseudoReadFile &header)
+{
+	uint32_t fntOffset, fntSize, fatOffset, fatSize;
+	NitroFS::ReadHeader(header, file.Size(), fntOffset, fntSize, fatOffset, fatSize);
+
+	PseudoReadFile fnt, fat;
+	fnt.GetDataFromFile(file, fntOffset, fntSize);
+	fat.GetDataFromFile(file, fatOffset, fatSize);
+	this->ReadTables(fnt, fat, file.Size());
+}
+
+void NitroFS::ReadHeader(PseudoReadFile &header, uint64_t romSize, uint32_t &fntOffset, uint32_t &fntSize, uint32_t &fatOffset, uint32_t &fatSize)
+{
+	header.pos = 0x40;
+	auto region = header.CheckRegion(16);
+	fntOffset = region.ReadLE<uint32_t>();
+	fntSize = region.ReadLE<uint32_t>();
+	fatOffset = region.ReadLE<uint32_t>();
+	fatSize = region.ReadLE<uint32_t>();
+
+	if (fntSize < 8 || static_cast<uint64_t>(fntOffset) + fntSize > romSize || fatSize % 8 || static_cast<uint64_t>(fatOffset) + fatSize > romSize)
+		throw std::runtime_error("NDS ROM header does not point to a valid NitroFS.");
+}
+
+void NitroFS::ReadTables(PseudoReadFile &fnt, PseudoReadFile &fat, uint64_t romSize)
+{
+	// Files with an invalid range are kept so the IDs still line up with the
+	// FNT, but are given no data
+	this->files.clear();
+	fat.pos = 0;
+	uint32_t fileCount = fat.Size() / 8;
+	auto table = fat.CheckRegion(fileCount, 8);
+	for (uint32_t i = 0; i < fileCount; ++i)
+	{
+		uint32_t start = table.ReadLE<uint32_t>(), end = table.ReadLE<uint32_t>();
+		if (start <= end && end <= romSize)
+			this->files.push_back(NitroFSFile(start, end - start));
+		else
+			this->files.push_back(NitroFSFile());
+	}
+
+	// The root's entry in the main directory table holds the total number of
+	// directories instead of a parent ID
+	fnt.pos = 6;
+	uint16_t dirCount = fnt.ReadLE<uint16_t>();
+	if (!dirCount || dirCount > 0x1000 || dirCount * 8u > fnt.Size())
+		throw std::runtime_error("NDS ROM has an invalid file name table.");
+	std::vector<bool> visited(dirCount, false);
+	this->ReadDirectory(fnt, 0, "", visited);
+}
+
+void NitroFS::ReadDirectory(PseudoReadFile &fnt, uint16_t dirID, const std::string &path, std::vector<bool> &visited)
+{
+	if (visited[dirID])
+		return;
+	visited[dirID] = true;
+
+	fnt.pos = dirID * 8;
+	auto entry = fnt.CheckRegion(8);
+	uint32_t subTableOffset = entry.ReadLE<uint32_t>();
+	uint16_t fileID = entry.ReadLE<uint16_t>();
+	if (subTableOffset >= fnt.Size())
+		throw std::runtime_error("NDS ROM has an invalid file name table.");
+
+	fnt.pos = subTableOffset;
+	for (;;)
+	{
+		uint8_t typeAndLength = fnt.ReadLE<uint8_t>();
+		if (!typeAndLength)
+			break;
+		auto name = std::vector<uint8_t>(typeAndLength & 0x7F);
+		if (name.empty())
+			throw std::runtime_error("NDS ROM has an invalid file name table.");
+		fnt.ReadLE(name);
+		std::string fullName = path + std::string(name.begin(), name.end());
+		if (typeAndLength & 0x80)
+		{
+			uint16_t subDirID = fnt.ReadLE<uint16_t>();
+			if ((subDirID & 0xF000) != 0xF000 || (subDirID & 0x0FFF) >= visited.size())
+				throw std::runtime_error("NDS ROM has an invalid file name table.");
+			uint32_t nextEntry = fnt.pos;
+			this->ReadDirectory(fnt, subDirID & 0x0FFF, fullName + "/", visited);
+			fnt.pos = nextEntry;
+		}
+		else
+		{
+			if (fileID < this->files.size())
+				this->files[fileID].path = fullName;
+			++fileID;
+		}
+	}
+}
@@ -0,0 +1,38 @@
+/*
+ * SDAT - NitroFS (NDS ROM filesystem) structures
+ * Last modification on 2026-10-16
+ *
+ * The ROM header gives the location of the FNT (file name table) at 0x40
+ * and of the FAT (file allocation table) at 0x48.  The FAT holds the start
+ * and end of every file by ID, and the FNT holds the directory tree that
+ * gives names to those IDs.  Files without a name (such as overlays) are
+ * still listed, just with an empty path.
+ */
+
+#pragma once
+
+#include "common.h"
+
+struct NitroFSFile
+{
+	std::string path;
+	uint32_t offset;
+	uint32_t size;
+
+	NitroFSFile(uint32_t fileOffset = 0, uint32_t fileSize = 0);
+};
+
+struct NitroFS
+{
+	std::vector<NitroFSFile> files;
+
+	NitroFS();
+
+	void Read(PseudoReadFile &file);
+	void Read(RangedFile &file, PseudoReadFile &header);
+
+private:
+	static void ReadHeader(PseudoReadFile &header, uint64_t romSize, uint32_t &fntOffset, uint32_t &fntSize, uint32_t &fatOffset, uint32_t &fatSize);
+	void ReadTables(PseudoReadFile &fnt, PseudoReadFile &fat, uint64_t romSize);
+	void ReadDirectory(PseudoReadFile &fnt, uint16_t dirID, const std::string &path, std::vector<bool> &visited);
+};
@@ -0,0 +1,125 @@
+/*
+ * SDAT - Ranged File structure
+ * Last modification on 2026-10-16
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include "RangedFile.h"
+#ifdef _WIN32
+# include "windowsh_wrapper.h"
+#else
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+RangedFile::RangedFile() : filename(""), size(0), inflating(),
+#ifdef _WIN32
+	file(INVALID_HANDLE_VALUE)
+#else
+	file(-1)
+#endif
+{
+}
+
+RangedFile::~RangedFile()
+{
+	this->Close();
+}
+
+void RangedFile::Open(const std::string &fn, const std::string &archiveExtension)
+{
+	this->Close();
+	this->filename = fn;
+	std::string archive, member;
+	if (SplitArchivePath(fn, archive, member))
+	{
+		std::unique_ptr<ZipMemberFile> newMember(new ZipMemberFile());
+		newMember->Open(archive, member, archiveExtension);
+		this->size = newMember->Size();
+		this->inflating = std::move(newMember);
+		return;
+	}
+	if (IsGzipFile(fn))
+	{
+		std::unique_ptr<GzipFile> newGzip(new GzipFile());
+		newGzip->Open(fn);
+		this->size = newGzip->Size();
+		this->inflating = std::move(newGzip);
+		return;
+	}
+#ifdef _WIN32
+	HANDLE fileHandle = CreateFileA(fn.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Unable to open " + fn + ".");
+	this->file = fileHandle;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize))
+	{
+		this->Close();
+		throw std::runtime_error("Unable to get the size of " + fn + ".");
+	}
+	this->size = fileSize.QuadPart;
+#else
+	this->file = open(fn.c_str(), O_RDONLY);
+	if (this->file == -1)
+		throw std::runtime_error("Unable to open " + fn + ".");
+	struct stat st;
+	if (fstat(this->file, &st))
+	{
+		this->Close();
+		throw std::runtime_error("Unable to get the size of " + fn + ".");
+	}
+	this->size = st.st_size;
+#endif
+}
+
+void RangedFile::Read(uint64_t offset, size_t count, std::vector<uint8_t> &buffer)
+{
+	if (this->inflating)
+	{
+		this->inflating->Read(offset, count, buffer);
+		return;
+	}
+
+	if (offset >= this->size)
+		count = 0;
+	else if (count > this->size - offset)
+		count = static_cast<size_t>(this->size - offset);
+	buffer.resize(count);
+
+	size_t done = 0;
+	while (done < count)
+	{
+		uint64_t position = offset + done;
+#ifdef _WIN32
+		OVERLAPPED overlapped = { };
+		overlapped.Offset = static_cast<DWORD>(position);
+		overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+		DWORD chunk = static_cast<DWORD>(std::min<size_t>(count - done, 0x40000000)), bytesRead = 0;
+		if (!ReadFile(this->file, &buffer[done], chunk, &bytesRead, &overlapped) || !bytesRead)
+			throw std::runtime_error("Unable to read from " + this->filename + ".");
+#else
+		ssize_t bytesRead = pread(this->file, &buffer[done], count - done, static_cast<off_t>(position));
+		if (bytesRead <= 0)
+			throw std::runtime_error("Unable to read from " + this->filename + ".");
+#endif
+		done += bytesRead;
+	}
+}
+
+void RangedFile::Close()
+{
+	this->inflating.reset();
+#ifdef _WIN32
+	if (this->file != INVALID_HANDLE_VALUE)
+		CloseHandle(this->file);
+	this->file = INVALID_HANDLE_VALUE;
+#else
+	if (this->file != -1)
+		close(this->file);
+	this->file = -1;
+#endif
+	this->size = 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * SDAT - Ranged File structure
+ * Last modification on 2026-10-16
+ *
+ * A file kept open for reading arbitrary byte ranges out of it (with pread,
+ * or overlapped ReadFile on Windows), so only the parts of a large ROM that
+ * are actually needed are ever read.  Members of zip archives and gzip files
+ * are read the same way by inflating them, see InflatingFile.h.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "ZipArchive.h"
+
+struct RangedFile
+{
+	RangedFile();
+	~RangedFile();
+
+	// Throws an exception if the file could not be opened, the extension is
+	// used to pick the member when given a zip archive without one, and gzip
+	// files are detected by their contents
+	void Open(const std::string &filename, const std::string &archiveExtension = "");
+
+	uint64_t Size() const { return this->size; }
+	bool IsCompressed() const { return !!this->inflating; }
+
+	// Reads up to count bytes from the given offset, stopping early at the end
+	// of the file, and throws an exception on a read error
+	void Read(uint64_t offset, size_t count, std::vector<uint8_t> &buffer);
+
+private:
+	std::string filename;
+	uint64_t size;
+	std::unique_ptr<InflatingFile> inflating;
+#ifdef _WIN32
+	void *file;
+#else
+	int file;
+#endif
+
+	void Close();
+
+	RangedFile(const RangedFile &);
+	RangedFile &operator=(const RangedFile &);
+};
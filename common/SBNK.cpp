@@ -15,16 +15,16 @@ SBNKInstrumentRange::SBNKInstrumentRange(uint8_t lowerNote, uint8_t upperNote, i
 {
 }
 
-void SBNKInstrumentRange::Read(PseudoReadFile &file)
+void SBNKInstrumentRange::Read(CheckedRegion &region)
 {
-	this->swav = file.ReadLE<uint16_t>();
-	this->swar = file.ReadLE<uint16_t>();
-	this->noteNumber = file.ReadLE<uint8_t>();
-	this->attackRate = file.ReadLE<uint8_t>();
-	this->decayRate = file.ReadLE<uint8_t>();
-	this->sustainLevel = file.ReadLE<uint8_t>();
-	this->releaseRate = file.ReadLE<uint8_t>();
-	this->pan = file.ReadLE<uint8_t>();
+	this->swav = region.ReadLE<uint16_t>();
+	this->swar = region.ReadLE<uint16_t>();
+	this->noteNumber = region.ReadLE<uint8_t>();
+	this->attackRate = region.ReadLE<uint8_t>();
+	this->decayRate = region.ReadLE<uint8_t>();
+	this->sustainLevel = region.ReadLE<uint8_t>();
+	this->releaseRate = region.ReadLE<uint8_t>();
+	this->pan = region.ReadLE<uint8_t>();
 }
 
 void SBNKInstrumentRange::Write(PseudoWrite &file) const
@@ -43,52 +43,57 @@ SBNKInstrument::SBNKInstrument() : record(0), ranges()
 {
 }
 
-void SBNKInstrument::Read(PseudoReadFile &file, uint32_t startOffset)
+// The instrument's header comes from the SBNK's table of instruments, while
+// its ranges are read from the file at the offset given in that header
+void SBNKInstrument::Read(CheckedRegion &table, PseudoReadFile &file, uint32_t startOffset)
 {
-	this->record = file.ReadLE<uint8_t>();
-	this->offset = file.ReadLE<uint16_t>();
-	this->unknown = file.ReadLE<uint8_t>();
-	uint32_t endOfInst = file.pos;
-	file.pos = startOffset + this->offset;
+	this->record = table.ReadLE<uint8_t>();
+	this->offset = table.ReadLE<uint16_t>();
+	this->unknown = table.ReadLE<uint8_t>();
 	if (this->record)
 	{
+		file.pos = startOffset + this->offset;
 		if (this->record == 16)
 		{
-			uint8_t lowNote = file.ReadLE<uint8_t>();
-			uint8_t highNote = file.ReadLE<uint8_t>();
+			auto notes = file.CheckRegion(2);
+			uint8_t lowNote = notes.ReadLE<uint8_t>();
+			uint8_t highNote = notes.ReadLE<uint8_t>();
 			uint8_t num = highNote - lowNote + 1;
+			auto region = file.CheckRegion(num, 12);
 			for (uint8_t i = 0; i < num; ++i)
 			{
-				uint16_t thisRecord = file.ReadLE<uint16_t>();
+				uint16_t thisRecord = region.ReadLE<uint16_t>();
 				auto range = SBNKInstrumentRange(lowNote + i, lowNote + i, thisRecord);
-				range.Read(file);
+				range.Read(region);
 				this->ranges.push_back(range);
 			}
 		}
 		else if (this->record == 17)
 		{
 			uint8_t thisRanges[8];
-			file.ReadLE(thisRanges);
-			uint8_t i = 0;
-			while (i < 8 && thisRanges[i])
+			file.CheckRegion(8).ReadLE(thisRanges);
+			uint8_t num = 0;
+			while (num < 8 && thisRanges[num])
+				++num;
+			auto region = file.CheckRegion(num, 12);
+			for (uint8_t i = 0; i < num; ++i)
 			{
-				uint16_t thisRecord = file.ReadLE<uint16_t>();
+				uint16_t thisRecord = region.ReadLE<uint16_t>();
 				uint8_t lowNote = i ? thisRanges[i - 1] + 1 : 0;
 				uint8_t highNote = thisRanges[i];
 				auto range = SBNKInstrumentRange(lowNote, highNote, thisRecord);
-				range.Read(file);
+				range.Read(region);
 				this->ranges.push_back(range);
-				++i;
 			}
 		}
 		else
 		{
 			auto range = SBNKInstrumentRange(0, 127, this->record);
-			range.Read(file);
+			auto region = file.CheckRegion(10);
+			range.Read(region);
 			this->ranges.push_back(range);
 		}
 	}
-	file.pos = endOfInst;
 }
 
 uint32_t SBNKInstrument::Size() const
@@ -162,7 +167,7 @@ SBNK::SBNK(const std::string &fn) : filename(fn), header(), count(0), instrument
 {
 }
 
-void SBNK::Read(PseudoReadFile &file)
+void SBNK::Read(PseudoReadFile &file, bool failOnMissingFiles)
 {
 	uint32_t startOfSBNK = file.pos;
 	this->header.Read(file);
@@ -172,22 +177,22 @@ void SBNK::Read(PseudoReadFile &file)
 	}
 	catch (const std::exception &)
 	{
-		if (SDAT::failOnMissingFiles)
+		if (failOnMissingFiles)
 			throw;
 		else
 			return;
 	}
+	auto data = file.CheckRegion(44);
 	int8_t type[4];
-	file.ReadLE(type);
+	data.ReadLE(type);
 	if (!VerifyHeader(type, "DATA"))
 		throw std::runtime_error("SBNK DATA structure invalid");
-	file.ReadLE<uint32_t>(); // size
-	uint32_t reserved[8];
-	file.ReadLE(reserved);
-	this->count = file.ReadLE<uint32_t>();
+	data.Skip(36); // size + 8 32-bit reserved
+	this->count = data.ReadLE<uint32_t>();
+	auto table = file.CheckRegion(this->count, 4);
 	this->instruments.resize(this->count);
 	for (uint32_t i = 0; i < this->count; ++i)
-		this->instruments[i].Read(file, startOfSBNK);
+		this->instruments[i].Read(table, file, startOfSBNK);
 }
 
 uint32_t SBNK::Size() const
@@ -214,6 +219,7 @@ void SBNK::FixOffsets()
 
 void SBNK::Write(PseudoWrite &file) const
 {
+	file.Reserve(this->header.fileSize);
 	this->header.Write(file);
 	file.WriteLE("DATA", 4);
 	uint32_t size = this->DataSize();
@@ -29,7 +29,7 @@ struct SBNKInstrumentRange
 
 	SBNKInstrumentRange(uint8_t lowerNote, uint8_t upperNote, int recordType);
 
-	void Read(PseudoReadFile &file);
+	void Read(CheckedRegion &region);
 	void Write(PseudoWrite &file) const;
 };
 
@@ -42,7 +42,7 @@ struct SBNKInstrument
 
 	SBNKInstrument();
 
-	void Read(PseudoReadFile &file, uint32_t startOffset);
+	void Read(CheckedRegion &table, PseudoReadFile &file, uint32_t startOffset);
 	uint32_t Size() const;
 	uint16_t FixOffset(uint16_t newOffset);
 	void WriteHeader(PseudoWrite &file) const;
@@ -60,7 +60,7 @@ struct SBNK
 
 	SBNK(const std::string &fn = "");
 
-	void Read(PseudoReadFile &file);
+	void Read(PseudoReadFile &file, bool failOnMissingFiles = true);
 	uint32_t Size() const;
 	uint32_t DataSize() const;
 	void FixOffsets();
@@ -12,8 +12,6 @@
 #include "SDAT.h"
 #include "TimerTrack.h"
 
-bool SDAT::failOnMissingFiles = true;
-
 SDAT::SDAT() : filename(""), header(), SYMBOffset(0), SYMBSize(0), INFOOffset(0), INFOSize(0), FATOffset(0), FATSize(0), FILEOffset(0), FILESize(0), symbSection(),
 	infoSection(), fatSection(), symbSectionNeedsCleanup(false), count(0), SSEQs(), SBNKs(), SWARs()
 {
@@ -99,8 +97,6 @@ SDAT &SDAT::operator=(const SDAT &sdat)
 
 void SDAT::Read(const std::string &fn, PseudoReadFile &file, bool shouldFailOnMissingFiles)
 {
-	SDAT::failOnMissingFiles = true;
-
 	this->filename = fn;
 
 	// Read header
@@ -130,8 +126,6 @@ void SDAT::Read(const std::string &fn, PseudoReadFile &file, bool shouldFailOnMi
 	if (this->infoSection.SEQrecord.entries.empty())
 		throw std::logic_error("No SSEQ records found in SDAT");
 
-	SDAT::failOnMissingFiles = shouldFailOnMissingFiles;
-
 	// Read files
 	for (size_t i = 0, entries = this->infoSection.SEQrecord.entries.size(); i < entries; ++i)
 	{
@@ -154,7 +148,7 @@ void SDAT::Read(const std::string &fn, PseudoReadFile &file, bool shouldFailOnMi
 		auto newSSEQ = std::unique_ptr<SSEQ>(new SSEQ(name, origName));
 		entry.sseq = newSSEQ.get();
 		newSSEQ->entryNumber = i;
-		newSSEQ->Read(file);
+		newSSEQ->Read(file, shouldFailOnMissingFiles);
 		this->SSEQs.push_back(std::move(newSSEQ));
 	}
 	for (size_t i = 0, entries = this->infoSection.BANKrecord.entries.size(); i < entries; ++i)
@@ -175,7 +169,7 @@ void SDAT::Read(const std::string &fn, PseudoReadFile &file, bool shouldFailOnMi
 		auto newSBNK = std::unique_ptr<SBNK>(new SBNK(origName));
 		entry.sbnk = newSBNK.get();
 		newSBNK->entryNumber = i;
-		newSBNK->Read(file);
+		newSBNK->Read(file, shouldFailOnMissingFiles);
 		this->SBNKs.push_back(std::move(newSBNK));
 	}
 	for (size_t i = 0, entries = this->infoSection.WAVEARCrecord.entries.size(); i < entries; ++i)
@@ -196,7 +190,7 @@ void SDAT::Read(const std::string &fn, PseudoReadFile &file, bool shouldFailOnMi
 		auto newSWAR = std::unique_ptr<SWAR>(new SWAR(origName));
 		entry.swar = newSWAR.get();
 		newSWAR->entryNumber = i;
-		newSWAR->Read(file);
+		newSWAR->Read(file, shouldFailOnMissingFiles);
 		this->SWARs.push_back(std::move(newSWAR));
 	}
 	for (size_t i = 0, entries = this->infoSection.PLAYERrecord.entries.size(); i < entries; ++i)
@@ -213,6 +207,41 @@ void SDAT::Read(const std::string &fn, PseudoReadFile &file, bool shouldFailOnMi
 }
 
 void SDAT::Write(PseudoWrite &file) const
+{
+	// The size was already worked out by FixOffsetsAndSizes, so the data only
+	// needs to be allocated once
+	file.Reserve(this->header.fileSize);
+
+	this->WriteSections(file);
+
+	// Write files
+	for (uint32_t i = 0; i < this->infoSection.SEQrecord.count; ++i)
+		file.WriteLE(this->infoSection.SEQrecord.entries[i].fileData);
+	for (uint32_t i = 0; i < this->infoSection.BANKrecord.count; ++i)
+		file.WriteLE(this->infoSection.BANKrecord.entries[i].fileData);
+	for (uint32_t i = 0; i < this->infoSection.WAVEARCrecord.count; ++i)
+		file.WriteLE(this->infoSection.WAVEARCrecord.entries[i].fileData);
+}
+
+// Same as above, but the files are referenced where they are instead of being
+// copied after the sections
+void SDAT::Write(GatherList &list) const
+{
+	// The sections are followed by the 0x18 byte FILE section header
+	list.head.Reserve(this->FILEOffset + 0x18);
+
+	this->WriteSections(list.head);
+
+	for (uint32_t i = 0; i < this->infoSection.SEQrecord.count; ++i)
+		list.Reference(this->infoSection.SEQrecord.entries[i].fileData);
+	for (uint32_t i = 0; i < this->infoSection.BANKrecord.count; ++i)
+		list.Reference(this->infoSection.BANKrecord.entries[i].fileData);
+	for (uint32_t i = 0; i < this->infoSection.WAVEARCrecord.count; ++i)
+		list.Reference(this->infoSection.WAVEARCrecord.entries[i].fileData);
+}
+
+// Writes everything up to and including the FILE section header
+void SDAT::WriteSections(PseudoWrite &file) const
 {
 	// Write header
 	this->header.Write(file);
@@ -243,14 +272,6 @@ void SDAT::Write(PseudoWrite &file) const
 	file.WriteLE(this->fatSection.count);
 	uint32_t other[] = { 0, 0, 0 };
 	file.WriteLE(other);
-
-	// Write files
-	for (uint32_t i = 0; i < this->infoSection.SEQrecord.count; ++i)
-		file.WriteLE(this->infoSection.SEQrecord.entries[i].fileData);
-	for (uint32_t i = 0; i < this->infoSection.BANKrecord.count; ++i)
-		file.WriteLE(this->infoSection.BANKrecord.entries[i].fileData);
-	for (uint32_t i = 0; i < this->infoSection.WAVEARCrecord.count; ++i)
-		file.WriteLE(this->infoSection.WAVEARCrecord.entries[i].fileData);
 }
 
 // Makes an SDAT from the current SDAT that contains only information for the SSEQ requested.
@@ -1139,7 +1160,7 @@ void SDAT::StripBanksAndWaveArcs()
 		auto &BankPatchMove = PatchMove[entry.bank];
 
 		PseudoReadFile file;
-		file.GetDataFromVector(sseq->data.begin(), sseq->data.end());
+		file.ViewData(sseq->data);
 
 		std::vector<uint8_t> newFileData = sseq->data;
 
@@ -16,6 +16,7 @@
 #include "SSEQ.h"
 #include "SBNK.h"
 #include "SWAR.h"
+#include "GatherList.h"
 #include "common.h"
 
 struct SDAT
@@ -24,8 +25,6 @@ struct SDAT
 	typedef std::vector<std::unique_ptr<SBNK>> SBNKList;
 	typedef std::vector<std::unique_ptr<SWAR>> SWARList;
 
-	static bool failOnMissingFiles;
-
 	std::string filename;
 	NDSStdHeader header;
 	uint32_t SYMBOffset;
@@ -54,6 +53,7 @@ struct SDAT
 
 	void Read(const std::string &fn, PseudoReadFile &file, bool shouldFailOnMissingFiles = true);
 	void Write(PseudoWrite &file) const;
+	void Write(GatherList &list) const;
 
 	SDAT MakeFromSSEQ(uint16_t SSEQNumber) const;
 
@@ -65,4 +65,7 @@ struct SDAT
 	SSEQList::iterator GetNonConstSSEQ(const SSEQ *sseq);
 	SBNKList::iterator GetNonConstSBNK(const SBNK *sbnk);
 	SWARList::iterator GetNonConstSWAR(const SWAR *swar);
+
+private:
+	void WriteSections(PseudoWrite &file) const;
 };
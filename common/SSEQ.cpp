@@ -15,7 +15,7 @@ SSEQ::SSEQ(const std::string &fn, const std::string &origFn) : filename(fn), ori
 {
 }
 
-void SSEQ::Read(PseudoReadFile &file)
+void SSEQ::Read(PseudoReadFile &file, bool failOnMissingFiles)
 {
 	uint32_t startOfSSEQ = file.pos;
 	NDSStdHeader header;
@@ -26,7 +26,7 @@ void SSEQ::Read(PseudoReadFile &file)
 	}
 	catch (const std::exception &)
 	{
-		if (SDAT::failOnMissingFiles)
+		if (failOnMissingFiles)
 			throw;
 		else
 			return;
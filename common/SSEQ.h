@@ -21,5 +21,5 @@ struct SSEQ
 
 	SSEQ(const std::string &fn = "", const std::string &origFn = "");
 
-	void Read(PseudoReadFile &file);
+	void Read(PseudoReadFile &file, bool failOnMissingFiles = true);
 };
@@ -38,7 +38,7 @@ SWAR &SWAR::operator=(const SWAR &swar)
 	return *this;
 }
 
-void SWAR::Read(PseudoReadFile &file)
+void SWAR::Read(PseudoReadFile &file, bool failOnMissingFiles)
 {
 	uint32_t startOfSWAR = file.pos;
 	this->header.Read(file);
@@ -48,21 +48,21 @@ void SWAR::Read(PseudoReadFile &file)
 	}
 	catch (const std::exception &)
 	{
-		if (SDAT::failOnMissingFiles)
+		if (failOnMissingFiles)
 			throw;
 		else
 			return;
 	}
+	auto data = file.CheckRegion(44);
 	int8_t type[4];
-	file.ReadLE(type);
+	data.ReadLE(type);
 	if (!VerifyHeader(type, "DATA"))
 		throw std::runtime_error("SWAR DATA structure invalid");
-	file.ReadLE<uint32_t>(); // size
-	uint32_t reserved[8];
-	file.ReadLE(reserved);
-	uint32_t count = file.ReadLE<uint32_t>();
+	data.Skip(36); // size + 8 32-bit reserved
+	uint32_t count = data.ReadLE<uint32_t>();
+	auto offsetTable = file.CheckRegion(count, 4);
 	auto offsets = std::vector<uint32_t>(count);
-	file.ReadLE(offsets);
+	offsetTable.ReadLE(offsets);
 	for (uint32_t i = 0; i < count; ++i)
 		if (offsets[i])
 		{
@@ -84,6 +84,7 @@ uint32_t SWAR::Size() const
 
 void SWAR::Write(PseudoWrite &file) const
 {
+	file.Reserve(this->header.fileSize);
 	this->header.Write(file);
 	file.WriteLE("DATA", 4);
 	file.WriteLE<uint32_t>(this->header.fileSize - 16);
@@ -29,7 +29,7 @@ struct SWAR
 	SWAR(const SWAR &swar);
 	SWAR &operator=(const SWAR &swar);
 
-	void Read(PseudoReadFile &file);
+	void Read(PseudoReadFile &file, bool failOnMissingFiles = true);
 	uint32_t Size() const;
 	void Write(PseudoWrite &file) const;
 };
@@ -8,6 +8,11 @@
  */
 
 #include "SWAV.h"
+#include "ThreadPool.h"
+
+// Guards the padded copies, which are shared by every player rendering with
+// the same SWAV
+static Mutex paddingMutex;
 
 static int ima_index_table[] =
 {
@@ -28,7 +33,7 @@ static int ima_step_table[] =
 	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
 };
 
-SWAV::SWAV() : waveType(0), loop(0), sampleRate(0), time(0), loopOffset(0), nonLoopLength(0), data()
+SWAV::SWAV() : waveType(0), loop(0), sampleRate(0), time(0), loopOffset(0), nonLoopLength(0), data(), paddedData(), paddedLoopData()
 {
 }
 
@@ -82,12 +87,13 @@ void SWAV::DecodeADPCM(uint32_t len)
 
 void SWAV::Read(PseudoReadFile &file)
 {
-	this->waveType = file.ReadLE<uint8_t>();
-	this->loop = file.ReadLE<uint8_t>();
-	this->sampleRate = file.ReadLE<uint16_t>();
-	this->time = file.ReadLE<uint16_t>();
-	this->loopOffset = this->origLoopOffset = file.ReadLE<uint16_t>();
-	this->nonLoopLength = this->origNonLoopLength = file.ReadLE<uint32_t>();
+	auto header = file.CheckRegion(12);
+	this->waveType = header.ReadLE<uint8_t>();
+	this->loop = header.ReadLE<uint8_t>();
+	this->sampleRate = header.ReadLE<uint16_t>();
+	this->time = header.ReadLE<uint16_t>();
+	this->loopOffset = this->origLoopOffset = header.ReadLE<uint16_t>();
+	this->nonLoopLength = this->origNonLoopLength = header.ReadLE<uint32_t>();
 	uint32_t size = (this->loopOffset + this->nonLoopLength) * 4;
 	this->origData.resize(size);
 	file.ReadLE(this->origData);
@@ -123,6 +129,40 @@ void SWAV::Read(PseudoReadFile &file)
 	}
 }
 
+// Create the padded copies of the data, silence before the start, and either
+// silence or the repeated loop after the end
+void SWAV::PadData() const
+{
+	MutexLocker lock(paddingMutex);
+	if (!this->paddedData.empty())
+		return;
+
+	uint32_t totalLength = std::max<uint32_t>(this->loopOffset + this->nonLoopLength, this->data.size());
+	bool looping = this->loop && this->nonLoopLength;
+	auto loopSample = [&](int64_t offset) -> int16_t
+	{
+		int64_t wrapped = offset % this->nonLoopLength;
+		if (wrapped < 0)
+			wrapped += this->nonLoopLength;
+		uint32_t index = this->loopOffset + wrapped;
+		return index < this->data.size() ? this->data[index] : 0;
+	};
+
+	this->paddedData.assign(totalLength + 2 * SWAV_PADDING, 0);
+	std::copy(this->data.begin(), this->data.end(), this->paddedData.begin() + SWAV_PADDING);
+	if (looping)
+		for (uint32_t i = 0; i < SWAV_PADDING; ++i)
+			this->paddedData[SWAV_PADDING + totalLength + i] = loopSample(totalLength + i - this->loopOffset);
+
+	this->paddedLoopData.clear();
+	if (looping)
+	{
+		this->paddedLoopData.resize(this->nonLoopLength + 2 * SWAV_PADDING);
+		for (uint32_t i = 0, len = this->paddedLoopData.size(); i < len; ++i)
+			this->paddedLoopData[i] = loopSample(static_cast<int64_t>(i) - SWAV_PADDING);
+	}
+}
+
 uint32_t SWAV::Size() const
 {
 	return this->origData.size() + 12;
@@ -11,6 +11,10 @@
 
 #include "common.h"
 
+// The number of samples of padding on either side of the padded data, must
+// be at least as large as the widest interpolation filter
+const uint32_t SWAV_PADDING = 8;
+
 struct SWAV
 {
 	uint8_t waveType;
@@ -23,11 +27,21 @@ struct SWAV
 	uint32_t nonLoopLength;
 	std::vector<uint8_t> origData;
 	std::vector<int16_t> data;
+	// Copies of the data with extra samples on either side, so the
+	// interpolating resampler never has to check bounds or loop points
+	// within its filter.  The second one only contains the looped section
+	// and is used once a channel has looped at least once.  They are only
+	// made by PadData when something is about to be rendered with them.
+	mutable std::vector<int16_t> paddedData;
+	mutable std::vector<int16_t> paddedLoopData;
 
 	SWAV();
 
 	void Read(PseudoReadFile &file);
 	void DecodeADPCM(uint32_t len);
+	// Makes the padded copies if they haven't been made yet, safe to call
+	// from several rendering threads at once
+	void PadData() const;
 	uint32_t Size() const;
 	void Write(PseudoWrite &file) const;
 };
@@ -16,8 +16,9 @@ SYMBRecord::SYMBRecord() : count(0), entryOffsets(), entries()
 void SYMBRecord::Read(PseudoReadFile &file, uint32_t startOffset)
 {
 	this->count = file.ReadLE<uint32_t>();
+	auto offsets = file.CheckRegion(this->count, 4);
 	this->entryOffsets.resize(this->count);
-	file.ReadLE(entryOffsets);
+	offsets.ReadLE(this->entryOffsets);
 	this->entries.resize(this->count);
 	for (uint32_t i = 0; i < this->count; ++i)
 		if (this->entryOffsets[i])
@@ -66,11 +67,12 @@ SYMBSection::SYMBSection() : size(0), SEQrecord(), BANKrecord(), WAVEARCrecord()
 void SYMBSection::Read(PseudoReadFile &file)
 {
 	uint32_t startOfSYMB = file.pos;
-	file.ReadLE(this->type);
+	auto header = file.CheckRegion(8 + sizeof(this->recordOffsets));
+	header.ReadLE(this->type);
 	if (!VerifyHeader(this->type, "SYMB"))
 		throw std::runtime_error("SDAT SYMB Section invalid");
-	this->size = file.ReadLE<uint32_t>();
-	file.ReadLE(this->recordOffsets);
+	this->size = header.ReadLE<uint32_t>();
+	header.ReadLE(this->recordOffsets);
 	if (this->recordOffsets[REC_SEQ])
 	{
 		file.pos = startOfSYMB + this->recordOffsets[REC_SEQ];
@@ -0,0 +1,207 @@
+/*
+ * SDAT - Signature scanning functions
+ * Last modification on 2026-10-16
+ */
+
+#include <algorithm>
+#include <memory>
+#include <cstring>
+#include "SignatureScan.h"
+#include "RangedFile.h"
+#include "ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define SIGNATURESCAN_SSE2
+# include <emmintrin.h>
+# ifdef _MSC_VER
+#  include <intrin.h>
+# endif
+#endif
+
+#undef min
+#undef max
+
+// Buffers smaller than this are not worth starting threads for
+static const size_t PARALLEL_SCAN_THRESHOLD = 8 << 20;
+static const size_t SCAN_CHUNK_SIZE = 1 << 20;
+// Blocks read from a file are large enough to still be scanned by the pool
+static const size_t SCAN_BLOCK_SIZE = PARALLEL_SCAN_THRESHOLD;
+
+// Large scans all share one pool, created by the first of them, instead of
+// starting and stopping threads for every scan (a compressed ROM is scanned
+// as one buffer per block).  As Wait waits for every job in the pool, the
+// mutex must be held for the whole of a scan that uses it.
+static Mutex scanPoolMutex;
+static std::unique_ptr<ThreadPool> scanPool;
+
+static ThreadPool &ScanPool()
+{
+	if (!scanPool)
+		scanPool.reset(new ThreadPool());
+	return *scanPool;
+}
+
+#ifdef SIGNATURESCAN_SSE2
+static inline unsigned LowestBit(unsigned mask)
+{
+# ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+# else
+	return __builtin_ctz(mask);
+# endif
+}
+#endif
+
+// Find the first match that starts within [begin, end), matches are allowed
+// to extend up to limit
+static const uint8_t *ScanRange(const uint8_t *begin, const uint8_t *end, const uint8_t *limit, const uint8_t *signature, size_t signatureSize)
+{
+	if (static_cast<size_t>(limit - begin) < signatureSize)
+		return nullptr;
+	const uint8_t *lastStart = std::min(end, limit - signatureSize + 1);
+	const uint8_t *curr = begin;
+
+#ifdef SIGNATURESCAN_SSE2
+	if (signatureSize >= 2)
+	{
+		__m128i first = _mm_set1_epi8(static_cast<char>(signature[0])), second = _mm_set1_epi8(static_cast<char>(signature[1]));
+		// Both loads stay within limit, as lastStart is at least 1 byte before it
+		for (; lastStart - curr >= 16; curr += 16)
+		{
+			__m128i firstMatches = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(curr)), first);
+			__m128i secondMatches = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(curr + 1)), second);
+			unsigned mask = _mm_movemask_epi8(_mm_and_si128(firstMatches, secondMatches));
+			while (mask)
+			{
+				const uint8_t *candidate = curr + LowestBit(mask);
+				if (!memcmp(candidate + 2, signature + 2, signatureSize - 2))
+					return candidate;
+				mask &= mask - 1;
+			}
+		}
+	}
+#endif
+
+	while (curr < lastStart)
+	{
+		curr = static_cast<const uint8_t *>(memchr(curr, signature[0], lastStart - curr));
+		if (!curr)
+			return nullptr;
+		if (!memcmp(curr + 1, signature + 1, signatureSize - 1))
+			return curr;
+		++curr;
+	}
+	return nullptr;
+}
+
+int64_t FindSignature(const uint8_t *data, size_t size, size_t start, const uint8_t *signature, size_t signatureSize)
+{
+	if (!signatureSize || start >= size)
+		return -1;
+
+	const uint8_t *limit = data + size;
+	if (size - start < PARALLEL_SCAN_THRESHOLD)
+	{
+		const uint8_t *match = ScanRange(data + start, limit, limit, signature, signatureSize);
+		return match ? match - data : -1;
+	}
+
+	// The chunks are scanned in rounds of one per thread, so a match near the
+	// start doesn't wait on a scan of the entire buffer
+	MutexLocker lock(scanPoolMutex);
+	ThreadPool &pool = ScanPool();
+	size_t threads = pool.ThreadCount();
+	std::vector<const uint8_t *> matches(threads);
+	for (size_t roundStart = start; roundStart < size; roundStart += threads * SCAN_CHUNK_SIZE)
+	{
+		for (size_t i = 0; i < threads; ++i)
+		{
+			size_t chunkStart = roundStart + i * SCAN_CHUNK_SIZE;
+			matches[i] = nullptr;
+			if (chunkStart >= size)
+				continue;
+			const uint8_t *chunkBegin = data + chunkStart, *chunkEnd = data + std::min(size, chunkStart + SCAN_CHUNK_SIZE);
+			const uint8_t **result = &matches[i];
+			pool.Enqueue([=]()
+			{
+				*result = ScanRange(chunkBegin, chunkEnd, limit, signature, signatureSize);
+			});
+		}
+		pool.Wait();
+		auto found = std::find_if(matches.begin(), matches.end(), [](const uint8_t *match) { return match != nullptr; });
+		if (found != matches.end())
+			return *found - data;
+	}
+	return -1;
+}
+
+std::vector<uint32_t> FindAllSignatures(const uint8_t *data, size_t size, const uint8_t *signature, size_t signatureSize)
+{
+	std::vector<uint32_t> offsets;
+	if (!signatureSize)
+		return offsets;
+
+	const uint8_t *limit = data + size;
+	size_t chunks = size < PARALLEL_SCAN_THRESHOLD ? 1 : (size + SCAN_CHUNK_SIZE - 1) / SCAN_CHUNK_SIZE;
+	std::vector<std::vector<uint32_t>> chunkOffsets(chunks);
+	auto scanChunk = [=](size_t chunk, std::vector<uint32_t> *results)
+	{
+		const uint8_t *curr = data + chunk * SCAN_CHUNK_SIZE;
+		const uint8_t *chunkEnd = chunks == 1 ? limit : data + std::min(size, (chunk + 1) * SCAN_CHUNK_SIZE);
+		while ((curr = ScanRange(curr, chunkEnd, limit, signature, signatureSize)))
+		{
+			results->push_back(static_cast<uint32_t>(curr - data));
+			++curr;
+		}
+	};
+
+	if (chunks == 1)
+		scanChunk(0, &chunkOffsets[0]);
+	else
+	{
+		MutexLocker lock(scanPoolMutex);
+		ThreadPool &pool = ScanPool();
+		for (size_t i = 0; i < chunks; ++i)
+		{
+			std::vector<uint32_t> *results = &chunkOffsets[i];
+			pool.Enqueue([=]()
+			{
+				scanChunk(i, results);
+			});
+		}
+		pool.Wait();
+	}
+
+	std::for_each(chunkOffsets.begin(), chunkOffsets.end(), [&](const std::vector<uint32_t> &chunkResults)
+	{
+		offsets.insert(offsets.end(), chunkResults.begin(), chunkResults.end());
+	});
+	return offsets;
+}
+
+void ScanFileForSignatures(RangedFile &file, const uint8_t *signature, size_t signatureSize, const ScannedBlock &scanned)
+{
+	if (!signatureSize)
+		return;
+
+	// Each block overlaps the previous one by one byte less than the
+	// signature, so a match that crosses from one block into the next is
+	// found exactly once
+	std::vector<uint8_t> block;
+	for (uint64_t blockStart = 0; blockStart < file.Size(); blockStart += block.size() - (signatureSize - 1))
+	{
+		file.Read(blockStart, SCAN_BLOCK_SIZE, block);
+		if (block.empty())
+			break;
+		auto offsets = FindAllSignatures(&block[0], block.size(), signature, signatureSize);
+		std::for_each(offsets.begin(), offsets.end(), [&](uint32_t &offset)
+		{
+			offset = static_cast<uint32_t>(blockStart + offset);
+		});
+		scanned(blockStart, block, offsets);
+		if (blockStart + block.size() >= file.Size())
+			break;
+	}
+}
@@ -0,0 +1,39 @@
+/*
+ * SDAT - Signature scanning functions
+ * Last modification on 2026-10-16
+ *
+ * Searches a buffer for a byte signature.  Candidates are found by comparing
+ * the first two bytes of the signature 16 positions at a time with SSE2 (or
+ * with memchr on the first byte otherwise), and buffers of several megabytes
+ * are split into chunks that are scanned by a pool of threads shared by every
+ * scan.  A match may start in one chunk and end in the next, so each chunk is
+ * allowed to read past its own end to complete a match.  Files that can't be
+ * mapped into memory (such as compressed ROMs) can instead be scanned a block
+ * at a time as they are read, with each block handed to the caller along with
+ * its matches, so that anything needed from the file can be taken from the
+ * blocks instead of reading (and inflating) the file a second time.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+struct RangedFile;
+
+// Returns the offset of the first match at or after start, or -1 if there is
+// none
+int64_t FindSignature(const uint8_t *data, size_t size, size_t start, const uint8_t *signature, size_t signatureSize);
+
+// Returns the offsets of every match, including overlapping ones, in order
+std::vector<uint32_t> FindAllSignatures(const uint8_t *data, size_t size, const uint8_t *signature, size_t signatureSize);
+
+// Reads the file from start to end a block at a time, so that it never has to
+// be in memory all at once, and calls scanned with each block, the offset of
+// the block within the file and the offsets within the file of the matches
+// that start in it, in order.  Each block overlaps the previous one by one
+// byte less than the signature.
+typedef std::function<void (uint64_t blockStart, const std::vector<uint8_t> &block, const std::vector<uint32_t> &offsets)> ScannedBlock;
+void ScanFileForSignatures(RangedFile &file, const uint8_t *signature, size_t signatureSize, const ScannedBlock &scanned);
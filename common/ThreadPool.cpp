@@ -0,0 +1,233 @@
+/*
+ * SDAT - Thread Pool structure
+ * Last modification on 2026-10-16
+ */
+
+#include <stdexcept>
+#include "ThreadPool.h"
+#ifndef _WIN32
+# include <unistd.h>
+#endif
+
+Mutex::Mutex()
+#ifdef _WIN32
+	: mutex(CreateMutex(nullptr, false, nullptr))
+#endif
+{
+#ifndef _WIN32
+	pthread_mutex_init(&this->mutex, nullptr);
+#endif
+}
+
+Mutex::~Mutex()
+{
+#ifdef _WIN32
+	CloseHandle(this->mutex);
+#else
+	pthread_mutex_destroy(&this->mutex);
+#endif
+}
+
+void Mutex::Lock()
+{
+#ifdef _WIN32
+	WaitForSingleObject(this->mutex, INFINITE);
+#else
+	pthread_mutex_lock(&this->mutex);
+#endif
+}
+
+void Mutex::Unlock()
+{
+#ifdef _WIN32
+	ReleaseMutex(this->mutex);
+#else
+	pthread_mutex_unlock(&this->mutex);
+#endif
+}
+
+ThreadPool::ThreadPool(unsigned threadCount, size_t maxQueuedJobs) : mutex(), threads(), queue(), maxQueued(maxQueuedJobs), pending(0), nextID(0), errorID(0), error(),
+	stopping(false)
+{
+	if (!threadCount)
+		threadCount = ThreadPool::HardwareThreads();
+#ifdef _WIN32
+	this->jobsAvailable = CreateSemaphore(nullptr, 0, 0x7FFFFFFF, nullptr);
+	this->slotsAvailable = this->maxQueued ? CreateSemaphore(nullptr, this->maxQueued, this->maxQueued, nullptr) : nullptr;
+	this->idle = CreateEvent(nullptr, true, true, nullptr);
+	for (unsigned i = 0; i < threadCount; ++i)
+	{
+		DWORD threadID;
+		HANDLE thread = CreateThread(nullptr, 0, ThreadPool::WorkerThread, this, 0, &threadID);
+		if (thread)
+			this->threads.push_back(thread);
+	}
+#else
+	pthread_cond_init(&this->jobsAvailable, nullptr);
+	pthread_cond_init(&this->slotsAvailable, nullptr);
+	pthread_cond_init(&this->idle, nullptr);
+	for (unsigned i = 0; i < threadCount; ++i)
+	{
+		pthread_t thread;
+		if (!pthread_create(&thread, nullptr, ThreadPool::WorkerThread, this))
+			this->threads.push_back(thread);
+	}
+#endif
+	if (this->threads.empty())
+		throw std::runtime_error("Unable to create any worker threads.");
+}
+
+ThreadPool::~ThreadPool()
+{
+	this->mutex.Lock();
+	this->stopping = true;
+	this->mutex.Unlock();
+#ifdef _WIN32
+	ReleaseSemaphore(this->jobsAvailable, this->threads.size(), nullptr);
+	for (size_t i = 0, len = this->threads.size(); i < len; ++i)
+	{
+		WaitForSingleObject(this->threads[i], INFINITE);
+		CloseHandle(this->threads[i]);
+	}
+	CloseHandle(this->jobsAvailable);
+	if (this->slotsAvailable)
+		CloseHandle(this->slotsAvailable);
+	CloseHandle(this->idle);
+#else
+	this->mutex.Lock();
+	pthread_cond_broadcast(&this->jobsAvailable);
+	this->mutex.Unlock();
+	for (size_t i = 0, len = this->threads.size(); i < len; ++i)
+		pthread_join(this->threads[i], nullptr);
+	pthread_cond_destroy(&this->jobsAvailable);
+	pthread_cond_destroy(&this->slotsAvailable);
+	pthread_cond_destroy(&this->idle);
+#endif
+}
+
+void ThreadPool::Enqueue(const Job &job)
+{
+#ifdef _WIN32
+	if (this->slotsAvailable)
+		WaitForSingleObject(this->slotsAvailable, INFINITE);
+	this->mutex.Lock();
+	this->queue.push_back(QueuedJob(job, this->nextID++));
+	if (!this->pending++)
+		ResetEvent(this->idle);
+	this->mutex.Unlock();
+	ReleaseSemaphore(this->jobsAvailable, 1, nullptr);
+#else
+	this->mutex.Lock();
+	while (this->maxQueued && this->queue.size() >= this->maxQueued)
+		pthread_cond_wait(&this->slotsAvailable, &this->mutex.mutex);
+	this->queue.push_back(QueuedJob(job, this->nextID++));
+	++this->pending;
+	pthread_cond_signal(&this->jobsAvailable);
+	this->mutex.Unlock();
+#endif
+}
+
+// Wait for all queued jobs to finish, rethrowing the first error if any occurred
+void ThreadPool::Wait()
+{
+#ifdef _WIN32
+	WaitForSingleObject(this->idle, INFINITE);
+	this->mutex.Lock();
+#else
+	this->mutex.Lock();
+	while (this->pending)
+		pthread_cond_wait(&this->idle, &this->mutex.mutex);
+#endif
+	std::exception_ptr firstError = this->error;
+	this->error = std::exception_ptr();
+	this->mutex.Unlock();
+	if (firstError)
+		std::rethrow_exception(firstError);
+}
+
+unsigned ThreadPool::HardwareThreads()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	long count = info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return count > 0 ? count : 1;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	for (;;)
+	{
+#ifdef _WIN32
+		WaitForSingleObject(this->jobsAvailable, INFINITE);
+		this->mutex.Lock();
+		if (this->queue.empty())
+		{
+			this->mutex.Unlock();
+			return;
+		}
+		QueuedJob current = this->queue.front();
+		this->queue.pop_front();
+		this->mutex.Unlock();
+		if (this->slotsAvailable)
+			ReleaseSemaphore(this->slotsAvailable, 1, nullptr);
+#else
+		this->mutex.Lock();
+		while (this->queue.empty() && !this->stopping)
+			pthread_cond_wait(&this->jobsAvailable, &this->mutex.mutex);
+		if (this->queue.empty())
+		{
+			this->mutex.Unlock();
+			return;
+		}
+		QueuedJob current = this->queue.front();
+		this->queue.pop_front();
+		pthread_cond_signal(&this->slotsAvailable);
+		this->mutex.Unlock();
+#endif
+
+		std::exception_ptr jobError;
+		try
+		{
+			current.job();
+		}
+		catch (...)
+		{
+			jobError = std::current_exception();
+		}
+
+		this->mutex.Lock();
+		if (jobError && (!this->error || current.id < this->errorID))
+		{
+			this->error = jobError;
+			this->errorID = current.id;
+		}
+		if (!--this->pending)
+		{
+#ifdef _WIN32
+			SetEvent(this->idle);
+#else
+			pthread_cond_broadcast(&this->idle);
+#endif
+		}
+		this->mutex.Unlock();
+	}
+}
+
+#ifdef _WIN32
+DWORD WINAPI ThreadPool::WorkerThread(void *handle)
+#else
+void *ThreadPool::WorkerThread(void *handle)
+#endif
+{
+	ThreadPool *pool = reinterpret_cast<ThreadPool *>(handle);
+	pool->WorkerLoop();
+#ifdef _WIN32
+	return 0;
+#else
+	return nullptr;
+#endif
+}
@@ -0,0 +1,152 @@
+/*
+ * SDAT - Thread Pool structure
+ * Last modification on 2026-10-16
+ *
+ * A small fixed-size pool of worker threads, using the same threading
+ * primitives as the timer player (WinAPI on Windows, pthreads elsewhere).
+ */
+
+#pragma once
+
+#include <functional>
+#include <algorithm>
+#include <exception>
+#include <vector>
+#include <deque>
+#include <cstdint>
+#ifdef _WIN32
+# include "windowsh_wrapper.h"
+#else
+# include <pthread.h>
+#endif
+
+struct Mutex
+{
+#ifdef _WIN32
+	HANDLE mutex;
+#else
+	pthread_mutex_t mutex;
+#endif
+
+	Mutex();
+	~Mutex();
+
+	void Lock();
+	void Unlock();
+
+private:
+	Mutex(const Mutex &);
+	Mutex &operator=(const Mutex &);
+};
+
+// Locks the given mutex for the lifetime of this object
+struct MutexLocker
+{
+	Mutex &mutex;
+
+	MutexLocker(Mutex &mtx) : mutex(mtx)
+	{
+		this->mutex.Lock();
+	}
+
+	~MutexLocker()
+	{
+		this->mutex.Unlock();
+	}
+
+private:
+	MutexLocker(const MutexLocker &);
+	MutexLocker &operator=(const MutexLocker &);
+};
+
+/*
+ * Jobs are run in the order they were queued, but may complete in any order.
+ * If maxQueued is non-zero, Enqueue will block while that many jobs are
+ * waiting for a worker.  Exceptions thrown by jobs are caught, and the one
+ * from the earliest queued job is rethrown by Wait.
+ */
+struct ThreadPool
+{
+	typedef std::function<void ()> Job;
+
+	ThreadPool(unsigned threadCount = 0, size_t maxQueued = 0);
+	~ThreadPool();
+
+	void Enqueue(const Job &job);
+	void Wait();
+	unsigned ThreadCount() const { return this->threads.size(); }
+
+	static unsigned HardwareThreads();
+
+private:
+	struct QueuedJob
+	{
+		Job job;
+		uint64_t id;
+
+		QueuedJob(const Job &newJob = Job(), uint64_t newID = 0) : job(newJob), id(newID) { }
+	};
+
+	Mutex mutex;
+#ifdef _WIN32
+	HANDLE jobsAvailable, slotsAvailable, idle;
+	std::vector<HANDLE> threads;
+#else
+	pthread_cond_t jobsAvailable, slotsAvailable, idle;
+	std::vector<pthread_t> threads;
+#endif
+	std::deque<QueuedJob> queue;
+	size_t maxQueued, pending;
+	uint64_t nextID, errorID;
+	std::exception_ptr error;
+	bool stopping;
+
+	void WorkerLoop();
+#ifdef _WIN32
+	static DWORD WINAPI WorkerThread(void *handle);
+#else
+	static void *WorkerThread(void *handle);
+#endif
+
+	ThreadPool(const ThreadPool &);
+	ThreadPool &operator=(const ThreadPool &);
+};
+
+/*
+ * Runs load on the pool for each of the items, and then merge on the calling
+ * thread for each of them in the order of the items, so that the results are
+ * merged exactly as if the items had been loaded one at a time.  Items are
+ * loaded a batch at a time, so only a batch's worth of results is ever held.
+ * load should only fill in the result it is given, and anything it throws is
+ * passed to merge instead, to be rethrown in order.
+ */
+template<typename Result, typename Item, typename Load, typename Merge> void LoadInOrder(ThreadPool &pool, const std::vector<Item> &items, Load load, Merge merge)
+{
+	size_t batchSize = std::max<size_t>(pool.ThreadCount(), 1) * 4;
+	for (size_t batchStart = 0, count = items.size(); batchStart < count; batchStart += batchSize)
+	{
+		size_t batchEnd = std::min(count, batchStart + batchSize);
+		std::vector<Result> results(batchEnd - batchStart);
+		std::vector<std::exception_ptr> errors(batchEnd - batchStart);
+		for (size_t i = batchStart; i < batchEnd; ++i)
+		{
+			const Item *item = &items[i];
+			Result *result = &results[i - batchStart];
+			std::exception_ptr *error = &errors[i - batchStart];
+			pool.Enqueue([=, &load]()
+			{
+				try
+				{
+					load(*item, *result);
+				}
+				catch (...)
+				{
+					*error = std::current_exception();
+				}
+			});
+		}
+		pool.Wait();
+		for (size_t i = batchStart; i < batchEnd; ++i)
+			merge(items[i], results[i - batchStart], errors[i - batchStart]);
+	}
+}
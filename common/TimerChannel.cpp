@@ -17,6 +17,11 @@
 #include "TimerChannel.h"
 #include "TimerPlayer.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define TIMERCHANNEL_SSE2
+# include <emmintrin.h>
+#endif
+
 static const int AMPL_K = 723;
 static const int AMPL_MIN = -AMPL_K;
 static const int AMPL_THRESHOLD = AMPL_MIN << 7;
@@ -41,7 +46,8 @@ static inline int Cnv_Sine(int arg)
 }
 
 NDSSoundRegister::NDSSoundRegister() : volumeMul(0), volumeDiv(0), panning(0), waveDuty(0), repeatMode(0), format(0), enable(false),
-	source(nullptr), timer(0), psgX(0), psgLast(0), psgLastCount(0), samplePosition(0), sampleIncrease(0), loopStart(0), length(0)
+	source(nullptr), timer(0), psgX(0), psgLast(0), psgLastCount(0), samplePosition(0), sampleIncrease(0), loopStart(0), length(0),
+	totalLength(0), looped(false)
 {
 }
 
@@ -452,6 +458,7 @@ void TimerChannel::Update()
 			this->reg.loopStart = this->tempReg.REPEAT_POINT;
 			this->reg.length = this->tempReg.LENGTH;
 			this->reg.totalLength = this->reg.loopStart + this->reg.length;
+			this->reg.looped = false;
 			this->ampl = AMPL_THRESHOLD;
 			this->state = CS_ATTACK;
 			// Fall down
@@ -650,17 +657,187 @@ int32_t TimerChannel::GenerateSample()
 	}
 }
 
-void TimerChannel::IncrementSample()
+// The scale is used when rendering, where there are multiple samples per clock cycle
+void TimerChannel::IncrementSample(double scale)
 {
-	this->reg.samplePosition += this->reg.sampleIncrease;
+	this->reg.samplePosition += this->reg.sampleIncrease * scale;
 	if (this->reg.format != 3 && this->reg.samplePosition >= this->reg.totalLength)
 	{
 		if (this->reg.repeatMode == 1)
 		{
 			while (this->reg.samplePosition >= this->reg.totalLength)
 				this->reg.samplePosition -= this->reg.length;
+			this->reg.looped = true;
 		}
 		else
 			this->Kill();
 	}
 }
+
+/*
+ * The filter tables used by the interpolating resampler.  Each has
+ * INTERPOLATION_PHASES rows (one for each fraction of a sample), with the
+ * coefficients in 2.14 fixed point so that they can be multiplied against
+ * the 16-bit samples directly.  The rows are normalized to sum to exactly 1
+ * so a constant input gives a constant output.  The cubic filter uses taps
+ * -1 to +2 around the current sample, the sinc filter uses taps -3 to +4.
+ */
+const int INTERPOLATION_PHASE_BITS = 10;
+const int INTERPOLATION_PHASES = 1 << INTERPOLATION_PHASE_BITS;
+const int INTERPOLATION_COEF_BITS = 14;
+
+template<size_t N> struct InterpolationTable
+{
+	int16_t coefs[INTERPOLATION_PHASES][N];
+
+	InterpolationTable(double (*filter)(double))
+	{
+		for (int phase = 0; phase < INTERPOLATION_PHASES; ++phase)
+		{
+			double frac = static_cast<double>(phase) / INTERPOLATION_PHASES, row[N], sum = 0;
+			for (size_t tap = 0; tap < N; ++tap)
+				sum += row[tap] = filter(static_cast<double>(tap) - (N / 2 - 1) - frac);
+			int total = 0;
+			for (size_t tap = 0; tap < N; ++tap)
+				total += this->coefs[phase][tap] = static_cast<int16_t>(std::floor(row[tap] / sum * (1 << INTERPOLATION_COEF_BITS) + 0.5));
+			// Put any rounding error into the tap nearest the position
+			this->coefs[phase][N / 2 - 1 + (frac >= 0.5 ? 1 : 0)] += (1 << INTERPOLATION_COEF_BITS) - total;
+		}
+	}
+};
+
+// Catmull-Rom spline
+static double CubicFilter(double x)
+{
+	x = std::abs(x);
+	if (x < 1)
+		return 1.5 * x * x * x - 2.5 * x * x + 1;
+	else if (x < 2)
+		return -0.5 * x * x * x + 2.5 * x * x - 4 * x + 2;
+	return 0;
+}
+
+// Blackman windowed sinc, the cutoff is fixed at the Nyquist frequency of the source
+static double SincFilter(double x)
+{
+	static const double PI = 3.14159265358979323846;
+	if (std::abs(x) >= 4)
+		return 0;
+	double sinc = std::abs(x) < 1e-9 ? 1.0 : std::sin(PI * x) / (PI * x);
+	return sinc * (0.42 + 0.5 * std::cos(PI * x / 4) + 0.08 * std::cos(PI * x / 2));
+}
+
+// These are built at startup so they are ready before any render threads start
+static const InterpolationTable<4> cubicTable(CubicFilter);
+static const InterpolationTable<8> sincTable(SincFilter);
+
+// Dot product of 4 or 8 samples against a row of coefficients
+static inline int32_t Interpolate4(const int16_t *samples, const int16_t *coefs)
+{
+#ifdef TIMERCHANNEL_SSE2
+	__m128i products = _mm_madd_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(samples)),
+		_mm_loadl_epi64(reinterpret_cast<const __m128i *>(coefs)));
+	products = _mm_add_epi32(products, _mm_shuffle_epi32(products, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(products) >> INTERPOLATION_COEF_BITS;
+#else
+	return (samples[0] * coefs[0] + samples[1] * coefs[1] + samples[2] * coefs[2] + samples[3] * coefs[3]) >> INTERPOLATION_COEF_BITS;
+#endif
+}
+
+static inline int32_t Interpolate8(const int16_t *samples, const int16_t *coefs)
+{
+#ifdef TIMERCHANNEL_SSE2
+	__m128i products = _mm_madd_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(samples)),
+		_mm_loadu_si128(reinterpret_cast<const __m128i *>(coefs)));
+	products = _mm_add_epi32(products, _mm_shuffle_epi32(products, _MM_SHUFFLE(1, 0, 3, 2)));
+	products = _mm_add_epi32(products, _mm_shuffle_epi32(products, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(products) >> INTERPOLATION_COEF_BITS;
+#else
+	int32_t sum = 0;
+	for (int i = 0; i < 8; ++i)
+		sum += samples[i] * coefs[i];
+	return sum >> INTERPOLATION_COEF_BITS;
+#endif
+}
+
+/*
+ * Generate a block of samples for this channel, advancing it the same way
+ * IncrementSample does.  PCM and ADPCM samples are read from the padded
+ * copies of the SWAV's data, so the kernels need no bounds checks, and the
+ * only branches are at the start of the sample and at the loop point.  PSG
+ * channels are square waves or noise and are not interpolated.  If the
+ * channel is killed partway through, the rest of the buffer is silence.
+ */
+void TimerChannel::GenerateSamples(int32_t *buffer, uint32_t count, double scale, Interpolation interpolation)
+{
+	if (this->reg.format == 3 || interpolation == INTERPOLATION_NONE)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (this->state == CS_NONE)
+			{
+				std::fill_n(buffer + i, count - i, 0);
+				return;
+			}
+			buffer[i] = this->GenerateSample();
+			this->IncrementSample(scale);
+		}
+		return;
+	}
+
+	const SWAV *swav = this->reg.source;
+	double increase = this->reg.sampleIncrease * scale;
+	bool canLoop = swav && this->reg.repeatMode == 1 && this->reg.length && !swav->paddedLoopData.empty();
+	uint32_t i = 0;
+	while (i < count)
+	{
+		// Silence until the hardware delay at the start of the sample has passed
+		for (; i < count && this->reg.samplePosition < 0; ++i)
+		{
+			buffer[i] = 0;
+			this->reg.samplePosition += increase;
+		}
+		// A channel that was just started has no source until its next update
+		if (!swav)
+		{
+			std::fill_n(buffer + i, count - i, 0);
+			return;
+		}
+
+		// Once looped, positions are relative to the loop start in the loop-only data
+		bool inLoop = this->reg.looped && canLoop;
+		uint32_t offset = inLoop ? this->reg.loopStart : 0;
+		const int16_t *data = (inLoop ? &swav->paddedLoopData[0] : &swav->paddedData[0]) + SWAV_PADDING;
+		double position = this->reg.samplePosition - offset, end = static_cast<double>(this->reg.totalLength) - offset;
+		for (; i < count && position < end; ++i)
+		{
+			uint32_t index = static_cast<uint32_t>(position);
+			uint32_t phase = static_cast<uint32_t>((position - index) * INTERPOLATION_PHASES);
+			switch (interpolation)
+			{
+				case INTERPOLATION_LINEAR:
+					buffer[i] = data[index] + (((data[index + 1] - data[index]) * static_cast<int32_t>(phase)) >> INTERPOLATION_PHASE_BITS);
+					break;
+				case INTERPOLATION_CUBIC:
+					buffer[i] = Interpolate4(data + index - 1, cubicTable.coefs[phase]);
+					break;
+				default:
+					buffer[i] = Interpolate8(data + index - 3, sincTable.coefs[phase]);
+			}
+			position += increase;
+		}
+		this->reg.samplePosition = position + offset;
+
+		if (i == count && this->reg.samplePosition < this->reg.totalLength)
+			break;
+		if (!canLoop)
+		{
+			this->Kill();
+			std::fill_n(buffer + i, count - i, 0);
+			return;
+		}
+		while (this->reg.samplePosition >= this->reg.totalLength)
+			this->reg.samplePosition -= this->reg.length;
+		this->reg.looped = true;
+	}
+}
@@ -50,6 +50,16 @@ enum { CS_NONE, CS_START, CS_ATTACK, CS_DECAY, CS_SUSTAIN, CS_RELEASE };
 
 enum { CF_UPDVOL, CF_UPDPAN, CF_UPDTMR, CF_BITS };
 
+// How samples are read from an SWAV when rendering, the player itself only
+// ever uses the nearest sample
+enum Interpolation
+{
+	INTERPOLATION_NONE,
+	INTERPOLATION_LINEAR,
+	INTERPOLATION_CUBIC,
+	INTERPOLATION_SINC
+};
+
 const uint32_t ARM7_CLOCK = 33513982;
 
 inline int SOUND_FREQ(int n) { return -0x1000000 / n; }
@@ -105,6 +115,10 @@ struct NDSSoundRegister
 
 	uint32_t totalLength;
 
+	// Set once the sample has gone past its end and wrapped to the loop
+	// start, not a DS register
+	bool looped;
+
 	NDSSoundRegister();
 
 	void ClearControlRegister();
@@ -184,5 +198,6 @@ struct TimerChannel
 	void UpdateTrack();
 	void Update();
 	int32_t GenerateSample();
-	void IncrementSample();
+	void IncrementSample(double scale = 1.0);
+	void GenerateSamples(int32_t *buffer, uint32_t count, double scale, Interpolation interpolation);
 };
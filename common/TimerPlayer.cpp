@@ -10,7 +10,10 @@
  * This has been modified in order to be able to provide timing for an SSEQ.
  */
 
+#include <limits>
+#include <cmath>
 #include "TimerPlayer.h"
+#include "LoudnessMeter.h"
 
 #undef min
 #undef max
@@ -22,7 +25,8 @@ TimerPlayer::TimerPlayer() : prio(0), nTracks(0), tempo(120), tempoCount(0), tem
 #else
 	mutex(PTHREAD_MUTEX_INITIALIZER), thread(0),
 #endif
-	maxSeconds(0), loops(0), doLength(false), doNotes(false), length()
+	maxSeconds(0), loops(0), doLength(false), doNotes(false), length(), abortReason(), sampleRate(0), samplesPerClockCycle(0), samplesUntilClockCycle(0),
+	interpolation(INTERPOLATION_NONE), channelBuffer(), mixBuffer(), loudness(nullptr), meterBuffer()
 {
 	memset(this->swar, 0, sizeof(this->swar));
 	for (int i = 0; i < 16; ++i)
@@ -39,7 +43,7 @@ void TimerPlayer::Setup(const SSEQ *sseqToPlay, const std::string &filename)
 	this->sseq = sseqToPlay;
 
 	PseudoReadFile file(filename);
-	file.GetDataFromVector(this->sseq->data.begin(), this->sseq->data.end());
+	file.ViewData(this->sseq->data);
 
 	this->tracks[0].Init(0, this, file);
 
@@ -98,7 +102,7 @@ void TimerPlayer::Run()
 
 			if (this->tracks[i].hitLoop)
 			{
-				this->trackTimes[i].push_back(Time(this->seconds, LOOP));
+				this->trackTimes[i].push_back(Time(this->seconds, LOOP, this->tracks[i].loopStartTime));
 				this->tracks[i].hitLoop = false;
 			}
 			if (this->tracks[i].hitEnd)
@@ -121,6 +125,34 @@ void TimerPlayer::UpdateTracks()
 		this->tracks[i].updateFlags.reset();
 }
 
+// When only timing, find out if none of the tracks that have not ended can get
+// to their next command before the time limit, so the player can stop now
+// instead of running until then.  Tracks that have looped enough times are
+// still included, as they can still change the volumes and tempo that the
+// other tracks depend on.
+void TimerPlayer::CheckForStall()
+{
+	if (!this->abortReason.empty())
+		return;
+
+	int minWait = -1;
+	for (uint8_t i = 0; i < this->nTracks; ++i)
+	{
+		if (this->tracks[i].state[TS_END])
+			continue;
+		if (minWait == -1 || this->tracks[i].wait < minWait)
+			minWait = this->tracks[i].wait;
+	}
+	if (minWait == -1)
+		return;
+
+	int tempoIncrease = (static_cast<int>(this->tempo) * static_cast<int>(this->tempoRate)) >> 8;
+	if (tempoIncrease <= 0)
+		this->abortReason = "the tempo is 0, so the tracks will never advance";
+	else if (this->seconds + minWait * 240.0 / tempoIncrease * SecondsPerClockCycle > this->maxSeconds)
+		this->abortReason = "the tracks that have not ended are all waiting until after the time limit";
+}
+
 Time TimerPlayer::Length()
 {
 	uint32_t tracksLooped = 0, tracksEnded = 0;
@@ -151,6 +183,25 @@ Time TimerPlayer::Length()
 	return Time(-1, LOOP);
 }
 
+// Get the first loop of the track that determined the length, its time is
+// where the loop ends and its loop start is where the loop begins, if the
+// song does not loop, the time will be -1
+Time TimerPlayer::LoopPoints() const
+{
+	double len = -1;
+	Time loop(-1, LOOP);
+	for (uint8_t i = 0; i < this->nTracks; ++i)
+	{
+		auto &times = this->trackTimes[i];
+		if (times.empty() || times[times.size() - 1].time <= len)
+			continue;
+		len = times[times.size() - 1].time;
+		auto firstLoop = std::find_if(times.begin(), times.end(), [](const Time &time) { return time.type == LOOP; });
+		loop = firstLoop == times.end() || times[times.size() - 1].type != LOOP ? Time(-1, LOOP) : *firstLoop;
+	}
+	return loop;
+}
+
 void TimerPlayer::LockMutex()
 {
 #ifdef _WIN32
@@ -174,6 +225,30 @@ static inline int32_t muldiv7(int32_t val, uint8_t mul)
 	return mul == 127 ? val : (val * mul) >> 7;
 }
 
+// Generate a single sample from all the active channels, advancing each
+// channel by the given fraction of a clock cycle's worth of samples
+void TimerPlayer::MixSample(double increaseScale, int32_t &leftChannel, int32_t &rightChannel)
+{
+	for (int i = 0; i < 16; ++i)
+	{
+		TimerChannel &chn = this->channels[i];
+
+		if (chn.state > CS_NONE)
+		{
+			int32_t sample = chn.GenerateSample();
+			chn.IncrementSample(increaseScale);
+
+			uint8_t datashift = chn.reg.volumeDiv;
+			if (datashift == 3)
+				datashift = 4;
+			sample = muldiv7(sample, chn.reg.volumeMul) >> datashift;
+
+			leftChannel += muldiv7(sample, 127 - chn.reg.panning);
+			rightChannel += muldiv7(sample, chn.reg.panning);
+		}
+	}
+}
+
 void TimerPlayer::GetLength()
 {
 	bool success = false;
@@ -187,33 +262,23 @@ void TimerPlayer::GetLength()
 			this->UnlockMutex();
 			if (!doingLength)
 			{
+				if (this->abortReason.empty())
+					this->abortReason = "timing took too long";
 				this->length = Time(-1, LOOP);
 				return;
 			}
 
 			if (this->doNotes)
 			{
+				// Every sample is needed for loudness, not only one per clock
+				// cycle, but it never changes what the length comes out as
+				if (this->loudness)
+					this->MeterClockCycle();
+
 				int32_t leftChannel = 0, rightChannel = 0;
 
 				// I need to advance the sound channels here
-				for (int i = 0; i < 16; ++i)
-				{
-					TimerChannel &chn = this->channels[i];
-
-					if (chn.state > CS_NONE)
-					{
-						int32_t sample = chn.GenerateSample();
-						chn.IncrementSample();
-
-						uint8_t datashift = chn.reg.volumeDiv;
-						if (datashift == 3)
-							datashift = 4;
-						sample = muldiv7(sample, chn.reg.volumeMul) >> datashift;
-
-						leftChannel += muldiv7(sample, 127 - chn.reg.panning);
-						rightChannel += muldiv7(sample, chn.reg.panning);
-					}
-				}
+				this->MixSample(1.0, leftChannel, rightChannel);
 
 				clamp(leftChannel, std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max());
 				clamp(rightChannel, std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max());
@@ -231,6 +296,11 @@ void TimerPlayer::GetLength()
 
 			this->Run();
 
+			if (!this->doNotes)
+				this->CheckForStall();
+			if (!this->abortReason.empty())
+				break;
+
 			if (this->doNotes && this->trailingSilenceSeconds >= 20.0)
 			{
 				double time = this->seconds - this->trailingSilenceSeconds;
@@ -249,16 +319,20 @@ void TimerPlayer::GetLength()
 				}
 			}
 			if (this->seconds > maxSeconds)
+			{
+				this->abortReason = "did not loop or end within " + stringify(maxSeconds) + " seconds";
 				break;
+			}
 		}
-		this->LockMutex();
-		this->doLength = false;
-		this->UnlockMutex();
 	}
-	catch (const std::exception &)
+	catch (const std::exception &e)
 	{
+		this->abortReason = e.what();
 		success = false;
 	}
+	this->LockMutex();
+	this->doLength = false;
+	this->UnlockMutex();
 	if (!success)
 		this->length = Time(-1, LOOP);
 }
@@ -297,3 +371,122 @@ void TimerPlayer::WaitForThread()
 	pthread_join(this->thread, nullptr);
 #endif
 }
+
+// Prepare the player to render samples at the given rate, the SSEQ, SBNK and
+// SWARs must already be set
+void TimerPlayer::SetupRender(uint32_t rate, Interpolation interpolationType)
+{
+	this->sampleRate = rate;
+	this->interpolation = interpolationType;
+	// The SWAVs are only padded once something is rendered with them, as the
+	// tools that never render would otherwise hold each sample several times
+	if (interpolationType != INTERPOLATION_NONE)
+		for (int i = 0; i < 4; ++i)
+			if (this->swar[i])
+				std::for_each(this->swar[i]->swavs.begin(), this->swar[i]->swavs.end(), [](const SWAR::SWAVs::value_type &swav) { swav.second->PadData(); });
+	this->samplesPerClockCycle = rate * SecondsPerClockCycle;
+	this->samplesUntilClockCycle = 0;
+	this->doNotes = true;
+	// The tracks will not run unless this is set, even though there is no length thread
+	this->doLength = true;
+}
+
+// Mix the given number of stereo frames from all the active channels given
+// into the buffer (interleaved left and right), advancing each channel by the
+// given fraction of a clock cycle per frame, and generating each channel as a
+// block as nothing about the channels changes until the next clock cycle
+void TimerPlayer::MixFrames(TimerChannel *mixChannels, int32_t *mix, uint32_t frames, double increaseScale)
+{
+	if (this->channelBuffer.size() < frames)
+		this->channelBuffer.resize(frames);
+
+	for (int i = 0; i < 16; ++i)
+	{
+		TimerChannel &chn = mixChannels[i];
+
+		if (chn.state > CS_NONE)
+		{
+			// The registers are cleared if the channel is killed while generating
+			uint8_t volumeMul = chn.reg.volumeMul, datashift = chn.reg.volumeDiv, panning = chn.reg.panning;
+			if (datashift == 3)
+				datashift = 4;
+
+			chn.GenerateSamples(&this->channelBuffer[0], frames, increaseScale, this->interpolation);
+
+			for (uint32_t j = 0; j < frames; ++j)
+			{
+				int32_t sample = muldiv7(this->channelBuffer[j], volumeMul) >> datashift;
+				mix[j * 2] += muldiv7(sample, 127 - panning);
+				mix[j * 2 + 1] += muldiv7(sample, panning);
+			}
+		}
+	}
+}
+
+// Clamp the mixed frames down to 16-bit samples
+static void ClampFrames(const int32_t *mix, int16_t *buffer, uint32_t frames)
+{
+	for (uint32_t i = 0; i < frames * 2; ++i)
+	{
+		int32_t sample = mix[i];
+		clamp(sample, std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max());
+		buffer[i] = sample;
+	}
+}
+
+// Render the given number of stereo frames into the buffer (interleaved left
+// and right), running the player once for every clock cycle passed
+void TimerPlayer::Render(int16_t *buffer, uint32_t frames)
+{
+	if (this->mixBuffer.size() < frames * 2)
+		this->mixBuffer.resize(frames * 2);
+	std::fill_n(this->mixBuffer.begin(), frames * 2, 0);
+
+	uint32_t frame = 0;
+	while (frame < frames)
+	{
+		while (this->samplesUntilClockCycle <= 0)
+		{
+			this->UpdateTracks();
+
+			for (int i = 0; i < 16; ++i)
+				this->channels[i].Update();
+
+			this->Run();
+
+			this->samplesUntilClockCycle += this->samplesPerClockCycle;
+		}
+
+		uint32_t blockFrames = std::min(frames - frame, static_cast<uint32_t>(std::ceil(this->samplesUntilClockCycle)));
+		this->MixFrames(this->channels, &this->mixBuffer[frame * 2], blockFrames, 1.0 / this->samplesPerClockCycle);
+		frame += blockFrames;
+		this->samplesUntilClockCycle -= blockFrames;
+	}
+
+	ClampFrames(&this->mixBuffer[0], buffer, frames);
+}
+
+// Render all the frames of one clock cycle into the loudness meter.  This is
+// done with a copy of the channels, stretched over exactly the frames of this
+// cycle, so the channels themselves are only advanced by the same one sample
+// per clock cycle as timing without the meter, and the length found is the
+// same either way.
+void TimerPlayer::MeterClockCycle()
+{
+	this->samplesUntilClockCycle += this->samplesPerClockCycle;
+	uint32_t frames = this->samplesUntilClockCycle > 0 ? static_cast<uint32_t>(std::ceil(this->samplesUntilClockCycle)) : 0;
+	if (!frames)
+		return;
+	this->samplesUntilClockCycle -= frames;
+
+	if (this->mixBuffer.size() < frames * 2)
+		this->mixBuffer.resize(frames * 2);
+	if (this->meterBuffer.size() < frames * 2)
+		this->meterBuffer.resize(frames * 2);
+	std::fill_n(this->mixBuffer.begin(), frames * 2, 0);
+	TimerChannel meterChannels[16];
+	std::copy(this->channels, this->channels + 16, meterChannels);
+	this->MixFrames(meterChannels, &this->mixBuffer[0], frames, 1.0 / frames);
+	ClampFrames(&this->mixBuffer[0], &this->meterBuffer[0], frames);
+	this->loudness->Add(&this->meterBuffer[0], frames);
+}
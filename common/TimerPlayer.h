@@ -36,8 +36,10 @@ struct Time
 {
 	double time;
 	TimeType type;
+	// For a loop, the time the commands being looped back to were first run
+	double loopStart;
 
-	Time(double tim = 0.0, TimeType typ = LOOP) : time(tim), type(typ)
+	Time(double tim = 0.0, TimeType typ = LOOP, double loopStrt = -1) : time(tim), type(typ), loopStart(loopStrt)
 	{
 	}
 };
@@ -47,6 +49,8 @@ const int MAXTRACKS = 32;
 
 enum { TYPE_PCM, TYPE_PSG, TYPE_NOISE };
 
+struct LoudnessMeter;
+
 struct TimerPlayer
 {
 	uint8_t prio, nTracks;
@@ -74,6 +78,18 @@ struct TimerPlayer
 	uint32_t maxSeconds, loops;
 	bool doLength, doNotes;
 	Time length;
+	// Why the length could not be found, if it was given up on early
+	std::string abortReason;
+
+	// Used when rendering the SSEQ to actual samples instead of only timing it
+	uint32_t sampleRate;
+	double samplesPerClockCycle, samplesUntilClockCycle;
+	Interpolation interpolation;
+	std::vector<int32_t> channelBuffer, mixBuffer;
+	// If set, the notes pass of GetLength also renders every sample into this,
+	// from a copy of the channels so that the timing is not affected
+	LoudnessMeter *loudness;
+	std::vector<int16_t> meterBuffer;
 
 	TimerPlayer();
 
@@ -88,10 +104,17 @@ struct TimerPlayer
 	int ChannelAlloc(int type, int priority);
 	void Run();
 	void UpdateTracks();
+	void CheckForStall();
 	Time Length();
+	Time LoopPoints() const;
 	void LockMutex();
 	void UnlockMutex();
+	void MixSample(double increaseScale, int32_t &leftChannel, int32_t &rightChannel);
 	void GetLength();
+	void SetupRender(uint32_t rate, Interpolation interpolationType = INTERPOLATION_NONE);
+	void MixFrames(TimerChannel *mixChannels, int32_t *mix, uint32_t frames, double increaseScale);
+	void Render(int16_t *buffer, uint32_t frames);
+	void MeterClockCycle();
 
 #ifdef _WIN32
 	static DWORD WINAPI GetLengthThread(void *handle);
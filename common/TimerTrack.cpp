@@ -40,9 +40,13 @@ static inline int Cnv_Fall(int fall)
 		return (0x1E00 / (0x7E - fall)) & 0xFFFF;
 }
 
+// The most commands a track may run without waiting before it is considered
+// to be stuck
+const uint32_t MAXCOMMANDSWITHOUTWAIT = 1 << 16;
+
 TimerTrack::TimerTrack() : trackId(-1), state(), prio(0), ply(nullptr), startPos(0), file(), stackPos(0), overriding(), lastComparisonResult(false), wait(0), patch(0), portaKey(0), portaTime(0),
 	sweepPitch(0), vol(0), expr(0), pan(0), pitchBendRange(0), pitchBend(0), transpose(0), a(0), d(0), s(0), r(0), modType(0), modSpeed(0), modDepth(0), modRange(0), modDelay(0), updateFlags(),
-	hitLoop(false), hitEnd(false)
+	hitLoop(false), hitEnd(false), firstRunTimes(), loopStartTime(-1)
 {
 	std::fill_n(&this->stack[0], TRACKSTACKSIZE, StackValue());
 	memset(this->loopCount, 0, sizeof(this->loopCount));
@@ -87,11 +91,22 @@ void TimerTrack::Init(uint8_t handle, TimerPlayer *player, const PseudoReadFile
 {
 	this->trackId = handle;
 	this->ply = player;
-	this->file.GetDataFromVector(source.data.begin(), source.data.end());
-	this->file.pos = this->startPos = source.pos;
+	// The source is normally a view of the SSEQ's data, so this does not copy it
+	this->file = source;
+	this->startPos = source.pos;
+	this->firstRunTimes.clear();
 	this->ClearState();
 }
 
+// Jump back to the given position for a loop, remembering when the loop started
+void TimerTrack::LoopTo(uint32_t pos)
+{
+	this->file.pos = pos;
+	this->hitLoop = true;
+	auto firstRunTime = this->firstRunTimes.find(pos);
+	this->loopStartTime = firstRunTime != this->firstRunTimes.end() ? firstRunTime->second : this->ply->seconds;
+}
+
 // Original FSS Function: Note_On
 int TimerTrack::NoteOn(int key, int vel, int len)
 {
@@ -487,8 +502,17 @@ void TimerTrack::Run()
 			return;
 	}
 
+	uint32_t commands = 0;
 	while (!this->wait)
 	{
+		if (!this->ply->abortReason.empty())
+			break;
+		if (++commands > MAXCOMMANDSWITHOUTWAIT)
+		{
+			this->ply->abortReason = "track " + stringify(static_cast<int>(this->trackId)) + " runs forever without waiting";
+			break;
+		}
+
 		this->ply->LockMutex();
 		bool doingLength = this->ply->doLength;
 		this->ply->UnlockMutex();
@@ -499,7 +523,11 @@ void TimerTrack::Run()
 		if (this->overriding())
 			cmd = this->overriding.cmd;
 		else
+		{
+			// Only adds the time if the position hasn't been run before
+			this->firstRunTimes.insert(std::make_pair(this->file.pos, this->ply->seconds));
 			cmd = this->Read8();
+		}
 		if (cmd < 0x80)
 		{
 			// Note on
@@ -544,8 +572,7 @@ void TimerTrack::Run()
 					break;
 
 				case SSEQ_CMD_GOTO:
-					this->file.pos = this->Read24();
-					this->hitLoop = true;
+					this->LoopTo(this->Read24());
 					break;
 
 				case SSEQ_CMD_CALL:
@@ -620,12 +647,12 @@ void TimerTrack::Run()
 						uint32_t rPos = this->stack[this->stackPos - 1].destPos;
 						uint8_t &nR = this->loopCount[this->stackPos - 1];
 						uint8_t prevR = nR;
-						if (!prevR || --nR)
+						if (!prevR)
+							this->LoopTo(rPos);
+						else if (--nR)
 							this->file.pos = rPos;
 						else
 							--this->stackPos;
-						if (!prevR)
-							this->hitLoop = true;
 					}
 					break;
 
@@ -823,7 +850,7 @@ std::pair<std::vector<uint16_t>, std::vector<uint32_t>> TimerTrack::GetPatches(c
 	std::vector<uint32_t> positions;
 
 	PseudoReadFile file;
-	file.GetDataFromVector(data.begin(), data.end());
+	file.ViewData(data);
 
 	uint32_t dataSize = data.size();
 
@@ -13,6 +13,7 @@
 #pragma once
 
 #include <functional>
+#include <map>
 #include <bitset>
 #include "SSEQ.h"
 #include "common.h"
@@ -91,11 +92,17 @@ struct TimerTrack
 	std::bitset<TUF_BITS> updateFlags;
 
 	bool hitLoop, hitEnd;
+	// When each position in the data that has been run was first run, so the
+	// start of a loop can be found when it loops back, only holding the
+	// positions reached instead of every position in the data
+	std::map<uint32_t, double> firstRunTimes;
+	double loopStartTime;
 
 	TimerTrack();
 
 	void ClearState();
 	void Init(uint8_t handle, TimerPlayer *player, const PseudoReadFile &source);
+	void LoopTo(uint32_t pos);
 	int NoteOn(int key, int vel, int len);
 	int NoteOnTie(int key, int vel);
 	void ReleaseAllNotes();
@@ -0,0 +1,227 @@
+/*
+ * SDAT - Zip archive structures
+ * Last modification on 2026-10-16
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <cctype>
+#include <ctime>
+#include "ZipArchive.h"
+#include "common.h"
+#include "unzip.h"
+#include "zip.h"
+
+static std::string ToLower(const std::string &str)
+{
+	std::string lower = str;
+	std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+	return lower;
+}
+
+static bool EndsWith(const std::string &str, const std::string &suffix)
+{
+	return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool SplitArchivePath(const std::string &path, std::string &archive, std::string &member)
+{
+	std::string lowerPath = ToLower(path);
+	size_t separator = lowerPath.find(".zip:");
+	if (separator != std::string::npos)
+	{
+		archive = path.substr(0, separator + 4);
+		member = path.substr(separator + 5);
+		return true;
+	}
+	if (EndsWith(lowerPath, ".zip"))
+	{
+		archive = path;
+		member = "";
+		return true;
+	}
+	return false;
+}
+
+std::string GetArchiveOutputPath(const std::string &path)
+{
+	std::string archive, member;
+	if (!SplitArchivePath(path, archive, member))
+		return EndsWith(ToLower(path), ".gz") ? path.substr(0, path.size() - 3) : path;
+	if (member.empty())
+		return archive;
+	size_t archiveSlash = archive.rfind('/'), memberSlash = member.rfind('/');
+	std::string directory = archiveSlash == std::string::npos ? "" : archive.substr(0, archiveSlash + 1);
+	return directory + (memberSlash == std::string::npos ? member : member.substr(memberSlash + 1));
+}
+
+ZipMemberFile::ZipMemberFile() : InflatingFile(), zip(nullptr)
+{
+}
+
+ZipMemberFile::~ZipMemberFile()
+{
+	this->Close();
+}
+
+static std::string GetCurrentMemberName(unzFile zip, unz_file_info64 &info)
+{
+	if (unzGetCurrentFileInfo64(zip, &info, nullptr, 0, nullptr, 0, nullptr, 0) != UNZ_OK)
+		return "";
+	std::vector<char> name(info.size_filename + 1);
+	unzGetCurrentFileInfo64(zip, &info, &name[0], name.size(), nullptr, 0, nullptr, 0);
+	return std::string(&name[0], info.size_filename);
+}
+
+void ZipMemberFile::Open(const std::string &archiveFilename, const std::string &memberFilename, const std::string &extension)
+{
+	this->Close();
+	this->filename = archiveFilename;
+	this->zip = unzOpen64(archiveFilename.c_str());
+	if (!this->zip)
+		throw std::runtime_error("Unable to open " + archiveFilename + " as a zip archive.");
+
+	if (!memberFilename.empty())
+	{
+		if (unzLocateFile(this->zip, memberFilename.c_str(), 0) != UNZ_OK)
+		{
+			this->Close();
+			throw std::runtime_error(archiveFilename + " does not contain " + memberFilename + ".");
+		}
+	}
+	else
+	{
+		// Only a file with the given extension is picked, unless it is the only
+		// file in the archive
+		std::vector<std::string> files, matches;
+		unz_file_info64 info;
+		for (int result = unzGoToFirstFile(this->zip); result == UNZ_OK; result = unzGoToNextFile(this->zip))
+		{
+			std::string name = GetCurrentMemberName(this->zip, info);
+			if (name.empty() || name[name.size() - 1] == '/')
+				continue;
+			files.push_back(name);
+			if (EndsWith(ToLower(name), extension))
+				matches.push_back(name);
+		}
+		if (matches.empty() && files.size() == 1)
+			matches = files;
+		if (matches.size() != 1)
+		{
+			this->Close();
+			if (matches.empty())
+				throw std::runtime_error(archiveFilename + " does not contain a " + extension + " file.");
+			throw std::runtime_error(archiveFilename + " contains more than one " + extension + " file, give the one to use as " + archiveFilename + ":<filename>.");
+		}
+		unzLocateFile(this->zip, matches[0].c_str(), 1);
+	}
+
+	unz_file_info64 info;
+	std::string member = GetCurrentMemberName(this->zip, info);
+	if (member.empty())
+	{
+		this->Close();
+		throw std::runtime_error("Unable to read the contents of " + archiveFilename + ".");
+	}
+	this->filename = archiveFilename + ":" + member;
+	this->size = info.uncompressed_size;
+	this->Restart();
+}
+
+bool ZipMemberFile::Rewind()
+{
+	unzCloseCurrentFile(this->zip);
+	return unzOpenCurrentFile(this->zip) == UNZ_OK;
+}
+
+int ZipMemberFile::Inflate(uint8_t *buffer, unsigned count)
+{
+	return unzReadCurrentFile(this->zip, buffer, count);
+}
+
+void ZipMemberFile::Close()
+{
+	if (this->zip)
+	{
+		unzCloseCurrentFile(this->zip);
+		unzClose(this->zip);
+	}
+	this->zip = nullptr;
+	this->size = 0;
+	this->ResetWindow();
+}
+
+ZipArchiveWriter::ZipArchiveWriter() : zip(nullptr), filename(""), tempFilename(""), created(0)
+{
+}
+
+ZipArchiveWriter::~ZipArchiveWriter()
+{
+	if (this->zip)
+	{
+		zipClose(this->zip, nullptr);
+		remove(this->tempFilename.c_str());
+	}
+}
+
+void ZipArchiveWriter::Open(const std::string &archiveFilename)
+{
+	if (this->zip)
+		this->Close();
+	this->filename = archiveFilename;
+	this->tempFilename = archiveFilename + ".tmp";
+	this->zip = zipOpen64(this->tempFilename.c_str(), APPEND_STATUS_CREATE);
+	if (!this->zip)
+		throw std::runtime_error("Unable to create " + this->tempFilename + ".");
+	// All of the members are given the time the archive was created
+	this->created = time(nullptr);
+}
+
+bool ZipArchiveWriter::IsOpen() const
+{
+	return !!this->zip;
+}
+
+void ZipArchiveWriter::Store(const std::string &member, const std::vector<uint8_t> &data)
+{
+	zip_fileinfo info = zip_fileinfo();
+	const tm *local = localtime(&this->created);
+	if (local)
+	{
+		info.tmz_date.tm_sec = local->tm_sec;
+		info.tmz_date.tm_min = local->tm_min;
+		info.tmz_date.tm_hour = local->tm_hour;
+		info.tmz_date.tm_mday = local->tm_mday;
+		info.tmz_date.tm_mon = local->tm_mon;
+		info.tmz_date.tm_year = local->tm_year + 1900;
+	}
+
+	// Method 0 stores the data as it is, as an NCSF is already compressed
+	if (zipOpenNewFileInZip64(this->zip, member.c_str(), &info, nullptr, 0, nullptr, 0, nullptr, 0, 0, data.size() >= 0xFFFFFFFF) != ZIP_OK)
+		throw std::runtime_error("Unable to add " + member + " to " + this->filename + ".");
+	int result = data.empty() ? ZIP_OK : zipWriteInFileInZip(this->zip, &data[0], static_cast<unsigned>(data.size()));
+	if (zipCloseFileInZip(this->zip) != ZIP_OK || result != ZIP_OK)
+		throw std::runtime_error("Unable to write " + member + " to " + this->filename + ".");
+}
+
+void ZipArchiveWriter::Close()
+{
+	int result = zipClose(this->zip, nullptr);
+	this->zip = nullptr;
+	if (result != ZIP_OK)
+	{
+		remove(this->tempFilename.c_str());
+		throw std::runtime_error("Unable to finish writing " + this->filename + ".");
+	}
+	// The previous archive is replaced in a single step, so it is either
+	// still there or replaced by the finished one, whatever happens
+	try
+	{
+		ReplaceFileWith(this->filename, this->tempFilename);
+	}
+	catch (const std::exception &)
+	{
+		remove(this->tempFilename.c_str());
+		throw;
+	}
+}
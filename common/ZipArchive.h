@@ -0,0 +1,76 @@
+/*
+ * SDAT - Zip archive structures
+ * Last modification on 2026-10-16
+ *
+ * Inputs can be given as archive.zip:member, or as just archive.zip when the
+ * archive holds only one file of the expected type.  The member is inflated
+ * as it is read instead of being extracted first, see InflatingFile.h.
+ *
+ * Output can also be written as a single archive, with each file stored as a
+ * member as it is finished and the central directory written at the end.
+ */
+
+#pragma once
+
+#include "InflatingFile.h"
+
+// Splits the given path into the archive and the member within it, returning
+// false if the path does not refer to a zip archive (the member is left empty
+// if the path was only to the archive)
+bool SplitArchivePath(const std::string &path, std::string &archive, std::string &member);
+
+// Gets the path that output for the given input should be named after, which
+// for a member of an archive is the member's filename next to the archive, and
+// for a gzip file is the filename without the .gz
+std::string GetArchiveOutputPath(const std::string &path);
+
+struct ZipMemberFile : InflatingFile
+{
+	ZipMemberFile();
+	~ZipMemberFile();
+
+	// Opens the member from the archive, if the member is empty then the only
+	// file in the archive with the given extension is used, throws an
+	// exception if the member could not be found or opened
+	void Open(const std::string &archive, const std::string &member, const std::string &extension);
+
+protected:
+	bool Rewind();
+	int Inflate(uint8_t *buffer, unsigned count);
+
+private:
+	void *zip;
+
+	void Close();
+};
+
+struct ZipArchiveWriter
+{
+	ZipArchiveWriter();
+	// If Close was not called, the unfinished archive is removed, leaving any
+	// existing file as it was
+	~ZipArchiveWriter();
+
+	// Creates the archive under a temporary name next to the given filename,
+	// which is only replaced once Close finishes it, throws an exception if the
+	// archive could not be created
+	void Open(const std::string &archiveFilename);
+	bool IsOpen() const;
+
+	// Adds the data as a member of the archive, stored without being
+	// compressed, throws an exception if the member could not be written
+	void Store(const std::string &member, const std::vector<uint8_t> &data);
+
+	// Writes the central directory, closes the archive and moves it over the
+	// given filename in a single step, throws an exception (removing the
+	// unfinished archive) if the archive could not be finished or moved
+	void Close();
+
+private:
+	void *zip;
+	std::string filename, tempFilename;
+	time_t created;
+
+	ZipArchiveWriter(const ZipArchiveWriter &);
+	ZipArchiveWriter &operator=(const ZipArchiveWriter &);
+};
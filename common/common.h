@@ -16,6 +16,7 @@
 #include <algorithm>
 #include <iostream>
 #include <cstring>
+#include <cstdio>
 #include <cctype>
 #include <cstdint>
 #include <sys/stat.h>
@@ -31,32 +32,114 @@
 #endif
 #ifdef _WIN32
 # define mkdir(dir, mode) _mkdir((dir))
+# include "windowsh_wrapper.h"
 #endif
 #include "optionparser.h"
+#include "MappedFile.h"
+#include "RangedFile.h"
+#include "SignatureScan.h"
 
 /*
  * Pseudo-file data structures
  *
  * The first structure is mainly so and entire can be loaded at once
- * and then "read" from the vector in this.
+ * and then "read" from the vector in this.  A CheckedRegion is a part of
+ * it that has already been bounds checked, for reading tables and fixed-size
+ * structures without checking every value.
  *
  * The second set of structures are wrappers around either an std::ofstream
- * or an std::vector of uint8_t to make it easier to write data to it.
+ * or an std::vector of uint8_t to make it easier to write data to it.  Writes
+ * to an std::ofstream are buffered, so they must be flushed before the file
+ * is closed.
  */
 
+// Loads a little endian value from memory that is known to be valid
+template<typename T> inline T LoadLE(const uint8_t *src)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	T finalVal = 0;
+	for (size_t i = 0; i < sizeof(T); ++i)
+		finalVal |= static_cast<T>(src[i]) << (i * 8);
+	return finalVal;
+#else
+	T finalVal;
+	memcpy(&finalVal, src, sizeof(T));
+	return finalVal;
+#endif
+}
+
+template<> inline uint8_t LoadLE<uint8_t>(const uint8_t *src)
+{
+	return *src;
+}
+
+// Stores a little endian value into memory that is known to be large enough
+template<typename T> inline void StoreLE(uint8_t *dest, const T &val)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	for (size_t i = 0; i < sizeof(T); ++i)
+		dest[i] = (val >> (i * 8)) & 0xFF;
+#else
+	memcpy(dest, &val, sizeof(T));
+#endif
+}
+
+struct CheckedRegion
+{
+	CheckedRegion(const uint8_t *start, size_t size) : current(start), end(start + size)
+	{
+	}
+
+	size_t Remaining() const { return this->end - this->current; }
+
+	template<typename T> T ReadLE()
+	{
+		T finalVal = LoadLE<T>(this->current);
+		this->current += sizeof(T);
+		return finalVal;
+	}
+
+	template<typename T, size_t N> void ReadLE(T (&arr)[N])
+	{
+		for (size_t i = 0; i < N; ++i)
+			arr[i] = this->ReadLE<T>();
+	}
+
+	template<size_t N> void ReadLE(uint8_t (&arr)[N])
+	{
+		memcpy(&arr[0], this->current, N);
+		this->current += N;
+	}
+
+	template<typename T> void ReadLE(std::vector<T> &arr)
+	{
+		for (size_t i = 0, len = arr.size(); i < len; ++i)
+			arr[i] = this->ReadLE<T>();
+	}
+
+	void Skip(size_t bytes)
+	{
+		this->current += bytes;
+	}
+
+private:
+	const uint8_t *current, *end;
+};
+
 struct PseudoReadFile
 {
 	std::string filename;
 	std::vector<uint8_t> data;
 	uint32_t pos, startOffset;
 
-	PseudoReadFile(const std::string &fn = "") : filename(fn), data(), pos(0), startOffset(0)
+	PseudoReadFile(const std::string &fn = "") : filename(fn), data(), pos(0), startOffset(0), mapping(), bytes(nullptr), length(0), borrowed(false)
 	{
 	}
 
 	PseudoReadFile(const PseudoReadFile &file) : filename(file.filename), data(file.data.begin(), file.data.end()), pos(file.pos),
-		startOffset(file.startOffset)
+		startOffset(file.startOffset), mapping(file.mapping), bytes(file.bytes), length(file.length), borrowed(file.borrowed)
 	{
+		this->UpdateView();
 	}
 
 	PseudoReadFile &operator=(const PseudoReadFile &file)
@@ -67,12 +150,32 @@ struct PseudoReadFile
 			this->data.assign(file.data.begin(), file.data.end());
 			this->pos = file.pos;
 			this->startOffset = file.startOffset;
+			this->mapping = file.mapping;
+			this->bytes = file.bytes;
+			this->length = file.length;
+			this->borrowed = file.borrowed;
+			this->UpdateView();
 		}
 		return *this;
 	}
 
+	// The bytes being read from, which are either in the data vector, in a
+	// memory mapping of the file or in memory borrowed through ViewData
+	const uint8_t *Data() const { return this->bytes; }
+	size_t Size() const { return this->length; }
+
 	void GetDataFromFile(const std::string &fn)
 	{
+		// Gzip files are inflated straight into memory, without a temporary file
+		if (IsGzipFile(fn))
+		{
+			RangedFile file;
+			file.Open(fn);
+			this->GetDataFromFile(file, 0, static_cast<size_t>(file.Size()));
+			this->filename = fn;
+			return;
+		}
+
 		this->filename = fn;
 		std::ifstream file;
 		file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
@@ -91,24 +194,93 @@ struct PseudoReadFile
 		file.read(reinterpret_cast<char *>(&this->data[0]), this->pos);
 		this->pos = this->startOffset = 0;
 		file.seekg(origPos, std::ifstream::beg);
+		this->mapping.reset();
+		this->borrowed = false;
+		this->UpdateView();
+	}
+
+	// Reads only the given range of the file, positions are then relative to
+	// the start of that range
+	void GetDataFromFile(RangedFile &file, uint64_t offset, size_t size)
+	{
+		file.Read(offset, size, this->data);
+		this->pos = this->startOffset = 0;
+		this->mapping.reset();
+		this->borrowed = false;
+		this->UpdateView();
+	}
+
+	// Maps the file into memory instead of reading all of it, for ROMs that
+	// can be hundreds of megabytes.  The data vector is left empty, and if the
+	// file can't be mapped (or is a gzip file) it is read the normal way
+	// instead.
+	void MapFile(const std::string &fn)
+	{
+		auto newMapping = std::make_shared<MappedFile>();
+		if (IsGzipFile(fn) || !newMapping->Open(fn))
+		{
+			this->GetDataFromFile(fn);
+			return;
+		}
+		this->filename = fn;
+		this->data.clear();
+		this->mapping = newMapping;
+		this->borrowed = false;
+		this->pos = this->startOffset = 0;
+		this->UpdateView();
 	}
 
 	template<typename InputIterator> void GetDataFromVector(InputIterator start, InputIterator end)
 	{
 		this->data.assign(start, end);
 		this->pos = this->startOffset = 0;
+		this->mapping.reset();
+		this->borrowed = false;
+		this->UpdateView();
+	}
+
+	// Reads from memory owned by someone else instead of copying it.  That
+	// memory must stay valid and unmodified for as long as this or any copy
+	// of this is being read from.
+	void ViewData(const uint8_t *start, size_t size)
+	{
+		this->data.clear();
+		this->mapping.reset();
+		this->bytes = size ? start : nullptr;
+		this->length = size;
+		this->borrowed = true;
+		this->pos = this->startOffset = 0;
+	}
+
+	void ViewData(const std::vector<uint8_t> &vec, size_t offset = 0)
+	{
+		if (offset >= vec.size())
+			this->ViewData(nullptr, 0);
+		else
+			this->ViewData(&vec[offset], vec.size() - offset);
 	}
 
 	template<typename T> T ReadLE()
 	{
-		if (this->startOffset + this->pos >= this->data.size() || this->startOffset + this->pos + sizeof(T) > this->data.size())
+		if (this->startOffset + this->pos >= this->length || this->startOffset + this->pos + sizeof(T) > this->length)
 			throw std::range_error("PseudoReadFile position was set past the end of the data.");
-		T finalVal = 0;
-		for (size_t i = 0; i < sizeof(T); ++i)
-			finalVal |= this->data[this->startOffset + this->pos++] << (i * 8);
+		T finalVal = LoadLE<T>(this->bytes + this->startOffset + this->pos);
+		this->pos += sizeof(T);
 		return finalVal;
 	}
 
+	// Checks that count elements of elementSize bytes each are available at the
+	// current position, and returns them as a region to read from without any
+	// further checks.  The position is moved past the region.
+	CheckedRegion CheckRegion(size_t count, size_t elementSize = 1)
+	{
+		size_t start = static_cast<size_t>(this->startOffset) + this->pos;
+		if (start > this->length || (elementSize && count > (this->length - start) / elementSize))
+			throw std::range_error("PseudoReadFile position was set past the end of the data.");
+		this->pos += static_cast<uint32_t>(count * elementSize);
+		return CheckedRegion(this->bytes + start, count * elementSize);
+	}
+
 	template<typename T, size_t N> void ReadLE(T (&arr)[N])
 	{
 		for (size_t i = 0; i < N; ++i)
@@ -117,9 +289,9 @@ struct PseudoReadFile
 
 	template<size_t N> void ReadLE(uint8_t (&arr)[N])
 	{
-		if (this->startOffset + this->pos >= this->data.size() || this->startOffset + this->pos + N > this->data.size())
+		if (this->startOffset + this->pos >= this->length || this->startOffset + this->pos + N > this->length)
 			throw std::range_error("PseudoReadFile position was set past the end of the data.");
-		memcpy(&arr[0], &this->data[this->startOffset + this->pos], N);
+		memcpy(&arr[0], this->bytes + this->startOffset + this->pos, N);
 		this->pos += N;
 	}
 
@@ -131,23 +303,22 @@ struct PseudoReadFile
 
 	void ReadLE(std::vector<uint8_t> &arr)
 	{
-		if (this->startOffset + this->pos >= this->data.size() || this->startOffset + this->pos + arr.size() > this->data.size())
+		if (this->startOffset + this->pos >= this->length || this->startOffset + this->pos + arr.size() > this->length)
 			throw std::range_error("PseudoReadFile position was set past the end of the data.");
-		memcpy(&arr[0], &this->data[this->startOffset + this->pos], arr.size());
+		memcpy(&arr[0], this->bytes + this->startOffset + this->pos, arr.size());
 		this->pos += arr.size();
 	}
 
 	std::string ReadNullTerminatedString()
 	{
-		char chr;
-		std::string str;
-		do
-		{
-			chr = static_cast<char>(this->ReadLE<uint8_t>());
-			if (chr)
-				str += chr;
-		} while (chr);
-		return str;
+		size_t start = static_cast<size_t>(this->startOffset) + this->pos;
+		if (start >= this->length)
+			throw std::range_error("PseudoReadFile position was set past the end of the data.");
+		auto strStart = this->bytes + start, strEnd = static_cast<const uint8_t *>(memchr(strStart, 0, this->length - start));
+		if (!strEnd)
+			throw std::range_error("PseudoReadFile position was set past the end of the data.");
+		this->pos += strEnd - strStart + 1;
+		return std::string(strStart, strEnd);
 	}
 
 	// The following 2 functions are only utilized by the SSEQ player.
@@ -173,32 +344,70 @@ struct PseudoReadFile
 	}
 
 	// The idea behind this function comes from VGMToolbox, however the actual functionality
-	// of it is much smoother than the one in VGMToolbox, as this leverages the std::search
-	// function to get the offset in the data vector
+	// of it is much smoother than the one in VGMToolbox, as this uses a vectorized (and for
+	// large files, multithreaded) scan to get the offset in the data
 	int32_t GetNextOffset(uint32_t startingOffset, const std::vector<uint8_t> &searchBytes)
 	{
-		int32_t ret = -1;
+		if (searchBytes.empty())
+			return -1;
+		return static_cast<int32_t>(FindSignature(this->bytes, this->length, startingOffset, &searchBytes[0], searchBytes.size()));
+	}
 
-		auto offset = std::search(this->data.begin() + startingOffset, this->data.end(), searchBytes.begin(), searchBytes.end());
-		if (offset != this->data.end())
-			ret = offset - this->data.begin();
+private:
+	std::shared_ptr<MappedFile> mapping;
+	const uint8_t *bytes;
+	size_t length;
+	bool borrowed;
 
-		return ret;
+	void UpdateView()
+	{
+		if (this->borrowed)
+			return;
+		if (this->mapping)
+		{
+			this->bytes = this->mapping->Data();
+			this->length = this->mapping->Size();
+		}
+		else
+		{
+			this->bytes = this->data.empty() ? nullptr : &this->data[0];
+			this->length = this->data.size();
+		}
 	}
 };
 
+// Values are encoded into a buffer that is written to the file in large
+// blocks, Flush must be called before the file is closed
 struct PseudoWriteFile
 {
 	std::ofstream *file;
 
-	PseudoWriteFile(std::ofstream *ofile) : file(ofile)
+	PseudoWriteFile(std::ofstream *ofile) : file(ofile), buffer(PSEUDOWRITEFILE_BUFFER_SIZE), used(0)
 	{
 	}
 
+	// Anything not yet flushed is only written here if the file is still open,
+	// and errors are ignored as they can't be thrown from a destructor
+	~PseudoWriteFile()
+	{
+		if (this->used && this->file->is_open())
+		{
+			try
+			{
+				this->Flush();
+			}
+			catch (const std::exception &)
+			{
+			}
+		}
+	}
+
 	template<typename T> void WriteLE(const T &val)
 	{
-		for (size_t i = 0; i < sizeof(T); ++i)
-			this->file->put((val >> (i * 8)) & 0xFF);
+		if (this->used + sizeof(T) > this->buffer.size())
+			this->Flush();
+		StoreLE(&this->buffer[this->used], val);
+		this->used += sizeof(T);
 	}
 
 	template<typename T, size_t N> void WriteLE(const T (&arr)[N])
@@ -209,7 +418,7 @@ struct PseudoWriteFile
 
 	template<size_t N> void WriteLE(const uint8_t (&arr)[N])
 	{
-		this->file->write(reinterpret_cast<const char *>(&arr[0]), N);
+		this->WriteBytes(&arr[0], N);
 	}
 
 	template<typename T> void WriteLE(const std::vector<T> &arr)
@@ -220,13 +429,51 @@ struct PseudoWriteFile
 
 	void WriteLE(const std::vector<uint8_t> &arr)
 	{
-		this->file->write(reinterpret_cast<const char *>(&arr[0]), arr.size());
+		if (!arr.empty())
+			this->WriteBytes(&arr[0], arr.size());
 	}
 
+	// Sizes past the end of the string are padded with zeroes
 	void WriteLE(const std::string &str, int32_t size = -1)
 	{
-		this->file->write(str.c_str(), size == -1 ? str.size() + 1 : size);
+		size_t finalSize = size == -1 ? str.size() + 1 : size;
+		size_t stringSize = std::min(finalSize, str.size() + 1);
+		this->WriteBytes(str.c_str(), stringSize);
+		for (size_t i = stringSize; i < finalSize; ++i)
+			this->WriteLE<uint8_t>(0);
+	}
+
+	void Flush()
+	{
+		if (this->used)
+			this->file->write(reinterpret_cast<const char *>(&this->buffer[0]), this->used);
+		this->used = 0;
+	}
+
+private:
+	static const size_t PSEUDOWRITEFILE_BUFFER_SIZE = 256 * 1024;
+
+	std::vector<uint8_t> buffer;
+	size_t used;
+
+	// Blocks at least as large as the buffer skip it entirely
+	void WriteBytes(const void *src, size_t size)
+	{
+		if (this->used + size > this->buffer.size())
+		{
+			this->Flush();
+			if (size >= this->buffer.size())
+			{
+				this->file->write(static_cast<const char *>(src), size);
+				return;
+			}
+		}
+		memcpy(&this->buffer[this->used], src, size);
+		this->used += size;
 	}
+
+	PseudoWriteFile(const PseudoWriteFile &);
+	PseudoWriteFile &operator=(const PseudoWriteFile &);
 };
 
 struct PseudoWriteVector
@@ -237,10 +484,18 @@ struct PseudoWriteVector
 	{
 	}
 
+	// Makes room for the given number of further bytes, so that writing them
+	// doesn't reallocate
+	void Reserve(size_t size)
+	{
+		this->data.reserve(this->data.size() + size);
+	}
+
 	template<typename T> void WriteLE(const T &val)
 	{
-		for (size_t i = 0; i < sizeof(T); ++i)
-			this->data.push_back((val >> (i * 8)) & 0xFF);
+		size_t pos = this->data.size();
+		this->data.resize(pos + sizeof(T));
+		StoreLE(&this->data[pos], val);
 	}
 
 	template<typename T, size_t N> void WriteLE(const T (&arr)[N])
@@ -265,12 +520,13 @@ struct PseudoWriteVector
 		this->data.insert(this->data.end(), arr.begin(), arr.end());
 	}
 
+	// Sizes past the end of the string are padded with zeroes
 	void WriteLE(const std::string &str, int32_t size = -1)
 	{
 		size_t finalSize = size == -1 ? str.size() + 1 : size;
-		auto strData = std::vector<uint8_t>(finalSize, 0);
-		memcpy(&strData[0], str.c_str(), finalSize);
-		this->data.insert(this->data.end(), strData.begin(), strData.end());
+		size_t stringSize = std::min(finalSize, str.size() + 1);
+		this->data.insert(this->data.end(), str.c_str(), str.c_str() + stringSize);
+		this->data.resize(this->data.size() + finalSize - stringSize, 0);
 	}
 };
 
@@ -341,6 +597,22 @@ struct PseudoWrite
 		else
 			this->vector->WriteLE(str, size);
 	}
+
+	// Makes room for the given number of further bytes when writing to a
+	// vector, for when the final size is already known
+	void Reserve(size_t size)
+	{
+		if (type == PSEUDOWRITE_VECTOR)
+			this->vector->Reserve(size);
+	}
+
+	// Writes out anything buffered for a file, must be called before the
+	// file is closed
+	void Flush()
+	{
+		if (type == PSEUDOWRITE_FILE)
+			this->file->Flush();
+	}
 };
 
 /*
@@ -588,6 +860,20 @@ inline void MakeDir(const std::string &dirName)
 	mkdir(dirName.c_str(), 0755);
 }
 
+// Move the second file given over the first, replacing the first in a single
+// step if it exists, throwing an exception (and leaving both files as they
+// were) if the move failed
+inline void ReplaceFileWith(const std::string &filename, const std::string &newFilename)
+{
+	// rename does not replace an existing file on Windows
+#ifdef _WIN32
+	if (!MoveFileExA(newFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+#else
+	if (rename(newFilename.c_str(), filename.c_str()))
+#endif
+		throw std::runtime_error("Unable to replace " + filename + " with " + newFilename + ".");
+}
+
 // Get just the filename from a path
 inline std::string GetFilenameFromPath(const std::string &path)
 {
@@ -613,6 +899,25 @@ inline std::string SecondsToString(double seconds)
 	return time;
 }
 
+// Convert a human readable time (as from SecondsToString, or the PSF length
+// and fade tags) back into seconds
+inline double StringToSeconds(const std::string &time)
+{
+	double seconds = 0;
+	size_t start = 0;
+	for (;;)
+	{
+		size_t colon = time.find(':', start);
+		std::string part = time.substr(start, colon == std::string::npos ? std::string::npos : colon - start);
+		std::replace(part.begin(), part.end(), ',', '.');
+		seconds = seconds * 60 + convertTo<double>(part);
+		if (colon == std::string::npos)
+			break;
+		start = colon + 1;
+	}
+	return seconds;
+}
+
 // Comes from http://techoverflow.net/blog/2013/01/25/efficiently-encoding-variable-length-integers-in-cc/
 // But modified to use a vector instead
 template<typename T> inline std::vector<uint8_t> EncodeVarLen(T value)